@@ -32,10 +32,12 @@
 #define DISTRHO_UI_CUSTOM_WIDGET_TYPE DGL_NAMESPACE::ImGuiTopLevelWidget
 #define DISTRHO_UI_URI DISTRHO_PLUGIN_URI "#UI"
 #define DISTRHO_UI_DEFAULT_WIDTH       1060
-#define DISTRHO_UI_DEFAULT_HEIGHT      690
+#define DISTRHO_UI_DEFAULT_HEIGHT      770
 #define DISTRHO_PLUGIN_IS_RT_SAFE      1
-#define DISTRHO_PLUGIN_NUM_INPUTS      0
-#define DISTRHO_PLUGIN_NUM_OUTPUTS     0
+#define DISTRHO_PLUGIN_NUM_INPUTS      1
+#define DISTRHO_PLUGIN_NUM_OUTPUTS     2
+#define DISTRHO_PLUGIN_WANT_MIDI_INPUT 1
+#define DISTRHO_PLUGIN_WANT_MIDI_OUTPUT 1
 #define DISTRHO_PLUGIN_WANT_STATE      1
 #define DISTRHO_UI_FILE_BROWSER        1
 #define DISTRHO_UI_USER_RESIZABLE      1
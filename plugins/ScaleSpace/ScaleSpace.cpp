@@ -14,10 +14,25 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 #include "DistrhoPlugin.hpp"
+#include "ScaleSpaceAtlas.hpp"
 #include "ScaleSpaceControls.hpp"
+#include "ScaleSpaceEditorLink.hpp"
+#include "ScaleSpaceGenerators.hpp"
+#include "ScaleSpaceHandoff.hpp"
+#include "ScaleSpaceJustIntonation.hpp"
+#include "ScaleSpaceMaster.hpp"
+#include "ScaleSpaceOverrides.hpp"
+#include "ScaleSpacePitchDetector.hpp"
+#include "ScaleSpacePreview.hpp"
+#include "ScaleSpaceScaleCache.hpp"
+#include "ScaleSpaceSysex.hpp"
+#include "ScaleSpaceTuningLog.hpp"
 #include "Tunings.h"
 #include "libMTSMaster.cpp"
 
@@ -33,7 +48,9 @@ class ScaleSpace : public Plugin
 public:
     ScaleSpace()
         : Plugin(kParameterCount, 0, kStateCount),
-          sampleRate(getSampleRate())
+          sampleRate(getSampleRate()),
+          editor_link(std::make_shared<EditorLink>()),
+          editor_link_id(EditorLinks::instance().publish(editor_link))
     {
         std::memset(fParameters, 0, sizeof(fParameters));
         
@@ -43,21 +60,99 @@ public:
             fParameters[i] = ParameterDefaults[i];
         }
         
+        // the editor looks this instance up by this id
+        fParameters[kParameterEditorLink] = static_cast<float>(editor_link_id);
+        
         sampleRateChanged(sampleRate);
         
-        tuning1 = Tunings::Tuning();
-        tuning2 = Tunings::Tuning();
-        tuning3 = Tunings::Tuning();
-        tuning4 = Tunings::Tuning();
+        tracked_x = ParameterDefaults[kParameterX];
+        tracked_y = ParameterDefaults[kParameterY];
+        tracked_target_x = tracked_x;
+        tracked_target_y = tracked_y;
+        
+        pad_x = tracked_x;
+        pad_y = tracked_y;
+        pad_point_count = 0;
+        std::memset(pad_msb, 0, sizeof(pad_msb));
+        std::memset(pad_lsb, 0, sizeof(pad_lsb));
+        
+        weights_dirty = true;
+        weights_x = tracked_x;
+        weights_y = tracked_y;
+        warp_dirty = true;
+        
+        tuning1 = ScaleCache::instance().standard();
+        tuning2 = tuning1;
+        tuning3 = tuning1;
+        tuning4 = tuning1;
+        
+        alignment_dirty = false;
         
         //Fill frequency arrays with default frequencies from tuning1
         
         for (int32_t i = 0; i < 128; i++)
         {
-            frequencies_in_hz[i] = tuning1.frequencyForMidiNote(i);;
-            target_frequencies_in_hz[i] = tuning1.frequencyForMidiNote(i);;
+            frequencies_in_hz[i] = tuning1->frequencies[i];
+            target_frequencies_in_hz[i] = tuning1->frequencies[i];
+            glide_from[i] = tuning1->frequencies[i];
+        }
+        
+        updateCornerTable(tuning1, 0);
+        updateCornerTable(tuning2, 1);
+        updateCornerTable(tuning3, 2);
+        updateCornerTable(tuning4, 3);
+        
+        for (int32_t c = 0; c < 4; c++)
+            updateGeneratedTable(c);
+        
+        updateStretchTable();
+        stretch_dirty = false;
+        
+        grid_tuning = tuning1;
+        updateGrid();
+        
+        for (int32_t s = 0; s < kSlotCount; s++)
+        {
+            slot_tunings[s] = tuning1;
+            updateSlotTable(s);
         }
         
+        atlas_generation = 0;
+        std::copy(target_frequencies_in_hz, target_frequencies_in_hz + 128, atlas_table);
+        atlas_period_keys = 12;
+        atlas_dirty = true;
+        atlas_x = tracked_x;
+        atlas_y = tracked_y;
+        
+        std::copy(target_frequencies_in_hz, target_frequencies_in_hz + 128, crossfade_from);
+        crossfade_position = 1.0;
+        active_slot = 0;
+        pending_slot = -1;
+        
+        std::memset(held_notes, 0, sizeof(held_notes));
+        preview_mode = kPreviewOff;
+        preview_chord_root = static_cast<int32_t>(ParameterDefaults[kParameterPreviewChordRoot]);
+        held_mask[0] = held_mask[1] = 0;
+        note_on_mask[0] = note_on_mask[1] = 0;
+        updateJustIntonationField();
+        
+        is_master = false;
+        was_master = false;
+        log_sample_time = 0;
+        mts_published = false;
+        deadband_open = false;
+        suppressed_updates = 0;
+        pad_velocity = 0.0;
+        velocity_x = tracked_x;
+        velocity_y = tracked_y;
+        publish_countdown = 0.0;
+        rate_publishes = 0;
+        rate_frames = 0;
+        sysex_enabled = false;
+        sysex_budget = 0.0;
+        sysex_cursor = 0;
+        std::memset(sysex_sent_words, 0xFF, sizeof(sysex_sent_words));
+        
         x_range_min = controlLimits[kParameterX].first;
 		x_range_max = controlLimits[kParameterX].second;
 		y_range_min = controlLimits[kParameterY].first;
@@ -65,6 +160,17 @@ public:
 		x_size = x_range_max - x_range_min;
 		y_size = y_range_max - y_range_min;
     }
+    
+    ~ScaleSpace() override
+    {
+        // hosts deactivate first, but never leave this instance waiting for the master slot
+        MasterTakeover::instance().withdraw(&is_master);
+        
+        if (is_master)
+            MTS_DeregisterMaster();
+        
+        EditorLinks::instance().withdraw(editor_link_id);
+    }
 
 protected:
    /* --------------------------------------------------------------------------------------------------------
@@ -138,8 +244,23 @@ protected:
     */
     void initAudioPort(bool input, uint32_t index, AudioPort& port) override
     {
-        // treat meter audio ports as stereo
-        port.groupId = kPortGroupMono;
+        // single mono input used for pitch tracking
+        if (input and index == 0)
+        {
+            port.groupId = kPortGroupMono;
+            port.name = "Pitch Input";
+            port.symbol = "pitch_in";
+            return;
+        }
+        
+        // stereo output for the preview voices
+        if (!input)
+        {
+            port.groupId = kPortGroupStereo;
+            port.name = index == 0 ? "Preview Left" : "Preview Right";
+            port.symbol = index == 0 ? "preview_left" : "preview_right";
+            return;
+        }
 
         // everything else is as default
         Plugin::initAudioPort(input, index, port);
@@ -170,180 +291,1657 @@ protected:
             parameter.ranges.max = controlLimits[index].second;
             parameter.ranges.def = ParameterDefaults[index];
             break;
-        }
-    }
-
-   /**
-      Initialize the state @a index.@n
-      This function will be called once, shortly after the plugin is created.
-    */
-    void initState(uint32_t index, State& state) override
-    {
-        switch (index)
-        {
-        case kStateFileSCL1:
-            state.key = "scl_file_1";
-            state.label = "SCL File 1";
+        case kParameterJustIntonation:
+            parameter.name = "Adaptive JI";
+            parameter.symbol = "adaptive_ji";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileSCL2:
-            state.key = "scl_file_2";
-            state.label = "SCL File 2";
+        case kParameterTrackingMode:
+            parameter.name = "Pitch Tracking";
+            parameter.symbol = "pitch_tracking";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            parameter.enumValues.count = kTrackingModeCount;
+            parameter.enumValues.restrictedMode = true;
+            {
+                ParameterEnumerationValue* const values = new ParameterEnumerationValue[kTrackingModeCount];
+                values[0].label = "Off";
+                values[0].value = kTrackingOff;
+                values[1].label = "Pitch Class";
+                values[1].value = kTrackingPitchClass;
+                values[2].label = "Auto Corner";
+                values[2].value = kTrackingCorner;
+                parameter.enumValues.values = values;
+            }
             break;
-        case kStateFileSCL3:
-            state.key = "scl_file_3";
-            state.label = "SCL File 3";
+        case kParameterTrackedX:
+            parameter.name = "Tracked X";
+            parameter.symbol = "tracked_x";
+            parameter.hints = kParameterIsOutput;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileSCL4:
-            state.key = "scl_file_4";
-            state.label = "SCL File 4";
+        case kParameterTrackedY:
+            parameter.name = "Tracked Y";
+            parameter.symbol = "tracked_y";
+            parameter.hints = kParameterIsOutput;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileKBM1:
-            state.key = "kbm_file_1";
-            state.label = "KBM File 1";
+        case kParameterDetectedPitch:
+            parameter.name = "Detected Pitch";
+            parameter.symbol = "detected_pitch";
+            parameter.unit = "Hz";
+            parameter.hints = kParameterIsOutput;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileKBM2:
-            state.key = "kbm_file_2";
-            state.label = "KBM File 2";
+        case kParameterSysexOutput:
+            parameter.name = "SysEx Output";
+            parameter.symbol = "sysex_output";
+            parameter.hints = kParameterIsAutomatable | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileKBM3:
-            state.key = "kbm_file_3";
-            state.label = "KBM File 3";
+        case kParameterSysexDevice:
+            parameter.name = "SysEx Device ID";
+            parameter.symbol = "sysex_device";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileKBM4:
-            state.key = "kbm_file_4";
-            state.label = "KBM File 4";
+        case kParameterGridStrength:
+            parameter.name = "Grid Strength";
+            parameter.symbol = "grid_strength";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
             break;
-        case kStateFileSavePath:
-            state.key = "file_save_path";
-            state.label = "File Save Path";
+        case kParameterZoneMode:
+            parameter.name = "Zone Mode";
+            parameter.symbol = "zone_mode";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            parameter.enumValues.count = kZoneModeCount;
+            parameter.enumValues.restrictedMode = true;
+            {
+                ParameterEnumerationValue* const values = new ParameterEnumerationValue[kZoneModeCount];
+                values[0].label = "Off";
+                values[0].value = kZoneModeOff;
+                values[1].label = "Zones";
+                values[1].value = kZoneModeZones;
+                values[2].label = "Gradient";
+                values[2].value = kZoneModeGradient;
+                parameter.enumValues.values = values;
+            }
             break;
-        }
-
-        state.hints = kStateIsFilenamePath;
-    }
-
-   /* --------------------------------------------------------------------------------------------------------
-    * Internal data */
-
-   /**
-      Get the current value of a parameter.
-      The host may call this function from any context, including realtime processing.
-    */
-    float getParameterValue(uint32_t index) const override
-    {
-        return fParameters[index];
-    }
-
-   /**
-      Change a parameter value.@n
-      The host may call this function from any context, including realtime processing.
-
-      This function will only be called for parameter inputs.
-    */
-    void setParameterValue(uint32_t index, float value) override
-    {
-		fParameters[index] = value;
-	}
-
-   /**
-      Change an internal state @a key to @a value.
-    */
-    void setState(const char* key, const char* value) override
-    {
-		// note: internal states seem to get set as soon as file chosen by file dialog, and could end up being anything
-
-        /**/ if (std::strcmp(key, "scl_file_1") == 0)
-        {
-		    loadScl(tuning1, value);
-		}
-        else if (std::strcmp(key, "scl_file_2") == 0)
-        {   
-			loadScl(tuning2, value);
-		}
-        else if (std::strcmp(key, "scl_file_3") == 0)
-	    {
-            loadScl(tuning3, value);
-        }
-        else if (std::strcmp(key, "scl_file_4") == 0)
-	    {
-            loadScl(tuning4, value);
-        }
-        else if (std::strcmp(key, "kbm_file_1") == 0)
-	    {
-            loadKbm(tuning1, value);
-        }
-        else if (std::strcmp(key, "kbm_file_2") == 0)
-	    {
-            loadKbm(tuning2, value);
-        }
-        else if (std::strcmp(key, "kbm_file_3") == 0)
-	    {
-            loadKbm(tuning3, value);
-        }
-        else if (std::strcmp(key, "kbm_file_4") == 0)
-	    {
-            loadKbm(tuning4, value);
-        }
-        else if (std::strcmp(key, "file_save_path") == 0)
-	    {
-            saveScale(value);
-        }
-    }
-    
-    void loadScl(Tunings::Tuning & tn, const char* value)
-    {
-		String filename(value);
-		auto k = tn.keyboardMapping;
+        case kParameterZone2Start:
+            parameter.name = "Zone 2 Start";
+            parameter.symbol = "zone_2_start";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone2X:
+            parameter.name = "Zone 2 X";
+            parameter.symbol = "zone_2_x";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone2Y:
+            parameter.name = "Zone 2 Y";
+            parameter.symbol = "zone_2_y";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone3Start:
+            parameter.name = "Zone 3 Start";
+            parameter.symbol = "zone_3_start";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone3X:
+            parameter.name = "Zone 3 X";
+            parameter.symbol = "zone_3_x";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone3Y:
+            parameter.name = "Zone 3 Y";
+            parameter.symbol = "zone_3_y";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone4Start:
+            parameter.name = "Zone 4 Start";
+            parameter.symbol = "zone_4_start";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone4X:
+            parameter.name = "Zone 4 X";
+            parameter.symbol = "zone_4_x";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterZone4Y:
+            parameter.name = "Zone 4 Y";
+            parameter.symbol = "zone_4_y";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGradientLow:
+            parameter.name = "Gradient Low Note";
+            parameter.symbol = "gradient_low";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGradientHigh:
+            parameter.name = "Gradient High Note";
+            parameter.symbol = "gradient_high";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterCornerGain1:
+            parameter.name = "Scale 1 Gain";
+            parameter.symbol = "corner_gain_1";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterCornerGain2:
+            parameter.name = "Scale 2 Gain";
+            parameter.symbol = "corner_gain_2";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterCornerGain3:
+            parameter.name = "Scale 3 Gain";
+            parameter.symbol = "corner_gain_3";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterCornerGain4:
+            parameter.name = "Scale 4 Gain";
+            parameter.symbol = "corner_gain_4";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterWarpX:
+            parameter.name = "X Warp";
+            parameter.symbol = "warp_x";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            setWarpCurveEnumValues(parameter);
+            break;
+        case kParameterWarpY:
+            parameter.name = "Y Warp";
+            parameter.symbol = "warp_y";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            setWarpCurveEnumValues(parameter);
+            break;
+        case kParameterWarpPower:
+            parameter.name = "Warp Power";
+            parameter.symbol = "warp_power";
+            parameter.hints = kParameterIsAutomatable | kParameterIsLogarithmic;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterAlignReference:
+            parameter.name = "Align Reference";
+            parameter.symbol = "align_reference";
+            parameter.hints = kParameterIsAutomatable | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterAlignNote:
+            parameter.name = "Reference Note";
+            parameter.symbol = "align_note";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterAlignFrequency:
+            parameter.name = "Reference Frequency";
+            parameter.symbol = "align_frequency";
+            parameter.unit = "Hz";
+            parameter.hints = kParameterIsAutomatable | kParameterIsLogarithmic;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterKeyswitchEnable:
+            parameter.name = "Keyswitches";
+            parameter.symbol = "keyswitch_enable";
+            parameter.hints = kParameterIsAutomatable | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterKeyswitchBase:
+            parameter.name = "Keyswitch Base Note";
+            parameter.symbol = "keyswitch_base";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterCrossfadeTime:
+            parameter.name = "Crossfade Time";
+            parameter.symbol = "crossfade_time";
+            parameter.unit = "ms";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterActiveSlot:
+            parameter.name = "Active Slot";
+            parameter.symbol = "active_slot";
+            parameter.hints = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterHoldNotes:
+            parameter.name = "Hold Sounding Notes";
+            parameter.symbol = "hold_notes";
+            parameter.hints = kParameterIsAutomatable | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterDeadband:
+            parameter.name = "Deadband";
+            parameter.symbol = "deadband";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterSuppressedUpdates:
+            parameter.name = "Suppressed Updates";
+            parameter.symbol = "suppressed_updates";
+            parameter.hints = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterUpdateRate:
+            parameter.name = "Update Rate";
+            parameter.symbol = "update_rate";
+            parameter.unit = "Hz";
+            parameter.hints = kParameterIsOutput;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterPassive:
+            parameter.name = "Passive";
+            parameter.symbol = "passive";
+            parameter.hints = kParameterIsOutput | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGenerator1:
+            parameter.name = "Scale 1 Generator";
+            parameter.symbol = "generator_1";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            setGeneratorEnumValues(parameter);
+            break;
+        case kParameterGeneratorSize1:
+            parameter.name = "Scale 1 Size";
+            parameter.symbol = "generator_size_1";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorInterval1:
+            parameter.name = "Scale 1 Generator Interval";
+            parameter.symbol = "generator_interval_1";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorPeriod1:
+            parameter.name = "Scale 1 Period";
+            parameter.symbol = "generator_period_1";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGenerator2:
+            parameter.name = "Scale 2 Generator";
+            parameter.symbol = "generator_2";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            setGeneratorEnumValues(parameter);
+            break;
+        case kParameterGeneratorSize2:
+            parameter.name = "Scale 2 Size";
+            parameter.symbol = "generator_size_2";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorInterval2:
+            parameter.name = "Scale 2 Generator Interval";
+            parameter.symbol = "generator_interval_2";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorPeriod2:
+            parameter.name = "Scale 2 Period";
+            parameter.symbol = "generator_period_2";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGenerator3:
+            parameter.name = "Scale 3 Generator";
+            parameter.symbol = "generator_3";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            setGeneratorEnumValues(parameter);
+            break;
+        case kParameterGeneratorSize3:
+            parameter.name = "Scale 3 Size";
+            parameter.symbol = "generator_size_3";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorInterval3:
+            parameter.name = "Scale 3 Generator Interval";
+            parameter.symbol = "generator_interval_3";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorPeriod3:
+            parameter.name = "Scale 3 Period";
+            parameter.symbol = "generator_period_3";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGenerator4:
+            parameter.name = "Scale 4 Generator";
+            parameter.symbol = "generator_4";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            setGeneratorEnumValues(parameter);
+            break;
+        case kParameterGeneratorSize4:
+            parameter.name = "Scale 4 Size";
+            parameter.symbol = "generator_size_4";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorInterval4:
+            parameter.name = "Scale 4 Generator Interval";
+            parameter.symbol = "generator_interval_4";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterGeneratorPeriod4:
+            parameter.name = "Scale 4 Period";
+            parameter.symbol = "generator_period_4";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterTranspose1:
+            parameter.name = "Scale 1 Transpose";
+            parameter.symbol = "transpose_1";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterTranspose2:
+            parameter.name = "Scale 2 Transpose";
+            parameter.symbol = "transpose_2";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterTranspose3:
+            parameter.name = "Scale 3 Transpose";
+            parameter.symbol = "transpose_3";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterTranspose4:
+            parameter.name = "Scale 4 Transpose";
+            parameter.symbol = "transpose_4";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterOctaveStretch:
+            parameter.name = "Octave Stretch";
+            parameter.symbol = "octave_stretch";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterReferenceTrim:
+            parameter.name = "Reference Trim";
+            parameter.symbol = "reference_trim";
+            parameter.unit = "cents";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterPreviewMode:
+            parameter.name = "Preview";
+            parameter.symbol = "preview_mode";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            parameter.enumValues.count = kPreviewModeCount;
+            parameter.enumValues.restrictedMode = true;
+            {
+                ParameterEnumerationValue* const values = new ParameterEnumerationValue[kPreviewModeCount];
+                values[0].label = "Off";
+                values[0].value = kPreviewOff;
+                values[1].label = "MIDI";
+                values[1].value = kPreviewMidi;
+                values[2].label = "Chord";
+                values[2].value = kPreviewChord;
+                parameter.enumValues.values = values;
+            }
+            break;
+        case kParameterPreviewLevel:
+            parameter.name = "Preview Level";
+            parameter.symbol = "preview_level";
+            parameter.hints = kParameterIsAutomatable;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterPreviewChordRoot:
+            parameter.name = "Preview Chord Root";
+            parameter.symbol = "preview_chord_root";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterLogEnable:
+            parameter.name = "Tuning Log";
+            parameter.symbol = "log_enable";
+            parameter.hints = kParameterIsAutomatable | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterAtlasEnable:
+            parameter.name = "Scale Atlas";
+            parameter.symbol = "atlas_enable";
+            parameter.hints = kParameterIsAutomatable | kParameterIsBoolean;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterAtlasNeighbours:
+            parameter.name = "Atlas Neighbours";
+            parameter.symbol = "atlas_neighbours";
+            parameter.hints = kParameterIsAutomatable | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterLogDropped:
+            parameter.name = "Dropped Log Entries";
+            parameter.symbol = "log_dropped";
+            parameter.hints = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterEditorLink:
+            parameter.name = "Editor Link";
+            parameter.symbol = "editor_link";
+            parameter.hints = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterReplacedNotes:
+            parameter.name = "Replaced Notes";
+            parameter.symbol = "replaced_notes";
+            parameter.hints = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        case kParameterClampedNotes:
+            parameter.name = "Clamped Notes";
+            parameter.symbol = "clamped_notes";
+            parameter.hints = kParameterIsOutput | kParameterIsInteger;
+            parameter.ranges.min = controlLimits[index].first;
+            parameter.ranges.max = controlLimits[index].second;
+            parameter.ranges.def = ParameterDefaults[index];
+            break;
+        }
+    }
+
+    static void setGeneratorEnumValues(Parameter& parameter)
+    {
+        parameter.enumValues.count = kGeneratorTypeCount;
+        parameter.enumValues.restrictedMode = true;
+        
+        ParameterEnumerationValue* const values = new ParameterEnumerationValue[kGeneratorTypeCount];
+        values[0].label = "File";
+        values[0].value = kGeneratorFile;
+        values[1].label = "EDO";
+        values[1].value = kGeneratorEDO;
+        values[2].label = "Harmonic";
+        values[2].value = kGeneratorHarmonic;
+        values[3].label = "Subharmonic";
+        values[3].value = kGeneratorSubharmonic;
+        values[4].label = "MOS";
+        values[4].value = kGeneratorMOS;
+        parameter.enumValues.values = values;
+    }
+    
+    static void setWarpCurveEnumValues(Parameter& parameter)
+    {
+        parameter.enumValues.count = kWarpCurveCount;
+        parameter.enumValues.restrictedMode = true;
+        
+        ParameterEnumerationValue* const values = new ParameterEnumerationValue[kWarpCurveCount];
+        values[0].label = "Linear";
+        values[0].value = kWarpLinear;
+        values[1].label = "Ease In";
+        values[1].value = kWarpEaseIn;
+        values[2].label = "Ease Out";
+        values[2].value = kWarpEaseOut;
+        values[3].label = "Ease In/Out";
+        values[3].value = kWarpEaseInOut;
+        values[4].label = "Power";
+        values[4].value = kWarpPower;
+        parameter.enumValues.values = values;
+    }
+
+   /**
+      Initialize the state @a index.@n
+      This function will be called once, shortly after the plugin is created.
+    */
+    void initState(uint32_t index, State& state) override
+    {
+        switch (index)
+        {
+        case kStateFileSCL1:
+            state.key = "scl_file_1";
+            state.label = "SCL File 1";
+            break;
+        case kStateFileSCL2:
+            state.key = "scl_file_2";
+            state.label = "SCL File 2";
+            break;
+        case kStateFileSCL3:
+            state.key = "scl_file_3";
+            state.label = "SCL File 3";
+            break;
+        case kStateFileSCL4:
+            state.key = "scl_file_4";
+            state.label = "SCL File 4";
+            break;
+        case kStateFileKBM1:
+            state.key = "kbm_file_1";
+            state.label = "KBM File 1";
+            break;
+        case kStateFileKBM2:
+            state.key = "kbm_file_2";
+            state.label = "KBM File 2";
+            break;
+        case kStateFileKBM3:
+            state.key = "kbm_file_3";
+            state.label = "KBM File 3";
+            break;
+        case kStateFileKBM4:
+            state.key = "kbm_file_4";
+            state.label = "KBM File 4";
+            break;
+        case kStateFileSavePath:
+            state.key = "file_save_path";
+            state.label = "File Save Path";
+            break;
+        case kStateFileSCLGrid:
+            state.key = "scl_file_grid";
+            state.label = "Grid SCL File";
+            break;
+        case kStateFileKBMGrid:
+            state.key = "kbm_file_grid";
+            state.label = "Grid KBM File";
+            break;
+        case kStateFileSCLSlot1:
+            state.key = "slot_scl_1";
+            state.label = "Slot 1 SCL File";
+            break;
+        case kStateFileSCLSlot2:
+            state.key = "slot_scl_2";
+            state.label = "Slot 2 SCL File";
+            break;
+        case kStateFileSCLSlot3:
+            state.key = "slot_scl_3";
+            state.label = "Slot 3 SCL File";
+            break;
+        case kStateFileSCLSlot4:
+            state.key = "slot_scl_4";
+            state.label = "Slot 4 SCL File";
+            break;
+        case kStateFileKBMSlot1:
+            state.key = "slot_kbm_1";
+            state.label = "Slot 1 KBM File";
+            break;
+        case kStateFileKBMSlot2:
+            state.key = "slot_kbm_2";
+            state.label = "Slot 2 KBM File";
+            break;
+        case kStateFileKBMSlot3:
+            state.key = "slot_kbm_3";
+            state.label = "Slot 3 KBM File";
+            break;
+        case kStateFileKBMSlot4:
+            state.key = "slot_kbm_4";
+            state.label = "Slot 4 KBM File";
+            break;
+        case kStateNoteOverrides:
+            state.key = "note_overrides";
+            state.label = "Note Overrides";
+            state.hints = 0x0;
+            return;
+        case kStateLogFile:
+            state.key = "log_file";
+            state.label = "Tuning Log File";
+            state.hints = 0x0;
+            return;
+        case kStateLibraryFolders:
+            state.key = "library_folders";
+            state.label = "Scale Library Folders";
+            state.hints = 0x0;
+            return;
+        case kStateLibraryPack:
+            state.key = "library_pack";
+            state.label = "Scale Pack File";
+            state.hints = 0x0;
+            return;
+        case kStateAtlasFile:
+            state.key = "atlas_file";
+            state.label = "Scale Atlas File";
+            state.hints = 0x0;
+            return;
+        }
+
+        state.hints = kStateIsFilenamePath;
+    }
+
+   /* --------------------------------------------------------------------------------------------------------
+    * Internal data */
+
+   /**
+      Get the current value of a parameter.
+      The host may call this function from any context, including realtime processing.
+    */
+    float getParameterValue(uint32_t index) const override
+    {
+        return fParameters[index];
+    }
+
+   /**
+      Change a parameter value.@n
+      The host may call this function from any context, including realtime processing.
+
+      This function will only be called for parameter inputs.
+    */
+    void setParameterValue(uint32_t index, float value) override
+    {
+		fParameters[index] = value;
+		
+		if (index == kParameterX)
+			pad_x = value;
+		else if (index == kParameterY)
+			pad_y = value;
+		
+		if (index >= kParameterZoneMode and index <= kParameterWarpPower)
+			weights_dirty = true;
+		
+		if (index >= kParameterWarpX and index <= kParameterWarpPower)
+			warp_dirty = true;
+		
+		if (index == kParameterAlignNote or index == kParameterAlignFrequency)
+			alignment_dirty = true;
+		
+		if (index >= kParameterGenerator1 and index <= kParameterGeneratorPeriod4)
+			generator_dirty[(index - kParameterGenerator1) / kGeneratorStride] = true;
+		
+		if (index == kParameterOctaveStretch)
+			stretch_dirty = atlas_dirty = true;
+		
+		if (index == kParameterAtlasEnable or index == kParameterAtlasNeighbours)
+			atlas_dirty = true;
+	}
+
+   /**
+      Change an internal state @a key to @a value.
+    */
+    void setState(const char* key, const char* value) override
+    {
+		// note: internal states seem to get set as soon as file chosen by file dialog, and could end up being anything
+
+        /**/ if (std::strcmp(key, "scl_file_1") == 0)
+        {
+		    loadScl(tuning1, value, kStateFileSCL1);
+		    updateCornerTable(tuning1, 0);
+		}
+        else if (std::strcmp(key, "scl_file_2") == 0)
+        {   
+			loadScl(tuning2, value, kStateFileSCL2);
+			updateCornerTable(tuning2, 1);
+		}
+        else if (std::strcmp(key, "scl_file_3") == 0)
+	    {
+            loadScl(tuning3, value, kStateFileSCL3);
+            updateCornerTable(tuning3, 2);
+        }
+        else if (std::strcmp(key, "scl_file_4") == 0)
+	    {
+            loadScl(tuning4, value, kStateFileSCL4);
+            updateCornerTable(tuning4, 3);
+        }
+        else if (std::strcmp(key, "kbm_file_1") == 0)
+	    {
+            loadKbm(tuning1, value, kStateFileKBM1);
+            updateCornerTable(tuning1, 0);
+        }
+        else if (std::strcmp(key, "kbm_file_2") == 0)
+	    {
+            loadKbm(tuning2, value, kStateFileKBM2);
+            updateCornerTable(tuning2, 1);
+        }
+        else if (std::strcmp(key, "kbm_file_3") == 0)
+	    {
+            loadKbm(tuning3, value, kStateFileKBM3);
+            updateCornerTable(tuning3, 2);
+        }
+        else if (std::strcmp(key, "kbm_file_4") == 0)
+	    {
+            loadKbm(tuning4, value, kStateFileKBM4);
+            updateCornerTable(tuning4, 3);
+        }
+        else if (std::strcmp(key, "scl_file_grid") == 0)
+	    {
+            loadScl(grid_tuning, value, kStateFileSCLGrid);
+            updateGrid();
+        }
+        else if (std::strcmp(key, "kbm_file_grid") == 0)
+	    {
+            loadKbm(grid_tuning, value, kStateFileKBMGrid);
+            updateGrid();
+        }
+        else if (std::strncmp(key, "slot_scl_", 9) == 0)
+        {
+            const int32_t slot = limit(std::atoi(key + 9) - 1, 0, kSlotCount - 1);
+            loadScl(slot_tunings[slot], value, static_cast<States>(kStateFileSCLSlot1 + slot));
+            updateSlotTable(slot);
+        }
+        else if (std::strncmp(key, "slot_kbm_", 9) == 0)
+        {
+            const int32_t slot = limit(std::atoi(key + 9) - 1, 0, kSlotCount - 1);
+            loadKbm(slot_tunings[slot], value, static_cast<States>(kStateFileKBMSlot1 + slot));
+            updateSlotTable(slot);
+        }
+        else if (std::strcmp(key, "note_overrides") == 0)
+        {
+            // parse into a new copy and hand it to run()
+            NoteOverrides* const overrides = new NoteOverrides;
+            overrides->parse(value);
+            note_overrides.publish(overrides);
+        }
+        else if (std::strcmp(key, "log_file") == 0)
+        {
+            tuning_log.setPath(value);
+        }
+        else if (std::strcmp(key, "atlas_file") == 0)
+        {
+            // load a new atlas and hand it to run(); the one it replaces is freed once run() has let it go
+            ScaleAtlas* const next = new ScaleAtlas;
+            
+            if (value[0] != '\0')
+                next->load(value);
+            
+            scale_atlas.publish(next);
+        }
+        else if (std::strcmp(key, "file_save_path") == 0)
+	    {
+            saveScale(value);
+        }
+    }
+    
+    // Scales and mappings come from the process-wide cache, so instances loading the
+    // same file share one parse and one built table. The outcome is published for
+    // the UI, which reads it instead of parsing the file again.
+    void loadScl(ScaleCache::Handle & tn, const char* value, const States stateId)
+    {
+		String filename(value);
+		ScaleParseResult result;
+		
+		if (filename.endsWith(".scl"))
+		{
+			try
+			{
+				tn = ScaleCache::instance().withScale(tn, value);
+				result.describe(tn, true, value, nullptr);
+				//d_stdout("ScaleSpace: tuning set to %s", value);
+			}
+			catch (const std::exception& e)
+			{
+				tn = ScaleCache::instance().standard();
+				result.describe(tn, true, value, e.what());
+				d_stdout("ScaleSpace:Exception when setting tuning");
+				d_stdout(e.what());
+			}
+			
+			editor_link->publishParseResult(stateId, result);
+		}
+		else
+		{
+			tn = ScaleCache::instance().withStandardScale(tn);
+			//d_stdout("ScaleSpace: tuning scl reset");
+		}
+	}
+	
+	void loadKbm(ScaleCache::Handle & tn, const char* value, const States stateId)
+	{
+		String filename(value);
+		ScaleParseResult result;
+		
+		if (filename.endsWith(".kbm"))
+		{
+			try
+			{
+				tn = ScaleCache::instance().withMapping(tn, value);
+				result.describe(tn, false, value, nullptr);
+				//d_stdout("ScaleSpace: tuning set to %s", value);
+			}
+			catch (const std::exception& e)
+			{
+				tn = ScaleCache::instance().standard();
+				result.describe(tn, false, value, e.what());
+				d_stdout("ScaleSpace:Exception when setting tuning");
+				d_stdout(e.what());
+			}
+			
+			editor_link->publishParseResult(stateId, result);
+		}
+		else
+		{
+			tn = ScaleCache::instance().withStandardMapping(tn);
+			//d_stdout("ScaleSpace: tuning kbm reset");
+		}
+	}
+	
+	// Cache the 128 note frequencies of a corner so run() can blend flat arrays
+	void updateCornerTable(const ScaleCache::Handle & tn, const int32_t corner)
+	{
+		std::copy(tn->frequencies, tn->frequencies + 128, file_frequencies_in_hz[corner]);
+		periodOf(tn, file_root_note[corner], file_period_keys[corner]);
+		
+		// a generated corner keeps the file table for when it is switched back
+		generator_dirty[corner] = true;
+	}
+	
+	// Fill a corner from its generator, or from its file table when the generator is off
+	void updateGeneratedTable(const int32_t corner)
+	{
+		const int32_t base = kParameterGenerator1 + corner * kGeneratorStride;
+		const int32_t type = static_cast<int32_t>(fParameters[base]);
+		const double size = fParameters[base + 1];
+		const double interval = fParameters[base + 2];
+		const double period = fParameters[base + 3];
+		double* const table = corner_frequencies_in_hz[corner];
+		
+		// generated scales start their period on the generator root; keys per period as each generator rounds its size
+		corner_root_note[corner] = ScaleGenerator::kRootNote;
+		
+		switch (type)
+		{
+		case kGeneratorEDO:
+			ScaleGenerator::equalDivisions(size, period, table);
+			corner_period_keys[corner] = std::max(1, static_cast<int32_t>(std::lround(size)));
+			break;
+		case kGeneratorHarmonic:
+			ScaleGenerator::harmonicSeries(size, false, period, table);
+			corner_period_keys[corner] = std::max(1, static_cast<int32_t>(std::ceil(size)));
+			break;
+		case kGeneratorSubharmonic:
+			ScaleGenerator::harmonicSeries(size, true, period, table);
+			corner_period_keys[corner] = std::max(1, static_cast<int32_t>(std::ceil(size)));
+			break;
+		case kGeneratorMOS:
+			ScaleGenerator::rankTwo(size, interval, period, table);
+			corner_period_keys[corner] = std::max(1, static_cast<int32_t>(std::lround(size)));
+			break;
+		default:
+			std::copy(file_frequencies_in_hz[corner], file_frequencies_in_hz[corner] + 128, table);
+			corner_root_note[corner] = file_root_note[corner];
+			corner_period_keys[corner] = file_period_keys[corner];
+			break;
+		}
+		
+		updateAlignedTable(corner);
+		stretch_dirty = true;
+	}
+	
+	// Per-note octave stretch factors for each corner, measured in octaves from the corner's own
+	// middle C so any scale stretches about the same point. Rebuilt at control rate only.
+	void updateStretchTable()
+	{
+		const double stretch = fParameters[kParameterOctaveStretch] / 1200.0;
+		
+		for (int32_t c = 0; c < 4; c++)
+		{
+			for (int32_t i = 0; i < 128; i++)
+			{
+				stretch_table[c][i] = std::exp2(stretch * stretchOctaves(corner_frequencies_in_hz[c], i));
+			}
+		}
+	}
+	
+	// Octaves from a table's stretch centre to note i, the exponent octave stretch scales;
+	// 0 where either frequency is unusable, so those notes are left alone
+	static double stretchOctaves(const double* frequencies, const int32_t i)
+	{
+		const double centre = frequencies[kStretchCentreNote];
+		const double octaves = (isFiniteFrequency(centre) and centre > 0.0) ? std::log2(frequencies[i] / centre) : 0.0;
+		return std::isfinite(octaves) ? octaves : 0.0;
+	}
+	
+	// Build a slot's table off the audio thread and hand it to run(), which picks it
+	// up at its next block; the table it replaces is freed once run() has let it go
+	void updateSlotTable(const int32_t slot)
+	{
+		SlotTable* const table = new SlotTable;
+		
+		std::copy(slot_tunings[slot]->frequencies, slot_tunings[slot]->frequencies + 128, table->frequencies);
+		periodOf(slot_tunings[slot], table->root_note, table->period_keys);
+		
+		for (int32_t i = 0; i < 128; i++)
+		{
+			table->stretch_octaves[i] = stretchOctaves(table->frequencies, i);
+		}
+		
+		slot_tables[slot].publish(table);
+	}
+	
+	// The key a scale and mapping pair starts its period on, and how many keys the period
+	// spans: the mapping's size, or the scale's size under the standard mapping
+	static void periodOf(const ScaleCache::Handle & tn, int32_t& root_note, int32_t& period_keys)
+	{
+		const Tunings::KeyboardMapping& mapping = tn->tuning.keyboardMapping;
+		root_note = mapping.middleNote;
+		period_keys = std::max(1, mapping.count > 0 ? mapping.count : tn->tuning.scale.count);
+	}
+	
+	// Rescale a corner table so its reference note sits at the common reference frequency.
+	// Kept next to the raw table, so switching alignment on or off costs nothing in run().
+	void updateAlignedTable(const int32_t corner)
+	{
+		const int32_t note = limit(static_cast<int32_t>(fParameters[kParameterAlignNote]), 0, 127);
+		const double reference = corner_frequencies_in_hz[corner][note];
+		const double scale = (isFiniteFrequency(reference) and reference > 0.0) ? fParameters[kParameterAlignFrequency] / reference : 1.0;
+		
+		for (int32_t i = 0; i < 128; i++)
+		{
+			aligned_frequencies_in_hz[corner][i] = corner_frequencies_in_hz[corner][i] * scale;
+		}
+	}
+	
+	// Raw or reference-aligned corner tables, as selected
+	const double (*cornerTables() const)[128]
+	{
+		return fParameters[kParameterAlignReference] > 0.5f ? aligned_frequencies_in_hz : corner_frequencies_in_hz;
+	}
+	
+	// Fill a warp lookup table mapping pad travel [0, 1] to blend position [0, 1]
+	static void buildWarpTable(const int32_t curve, const float power, float* table)
+	{
+		for (int32_t i = 0; i <= kWarpTableSize; i++)
+		{
+			const float t = static_cast<float>(i) / kWarpTableSize;
+			float warped;
+			
+			switch (curve)
+			{
+			case kWarpEaseIn:
+				warped = t * t;
+				break;
+			case kWarpEaseOut:
+				warped = 1.0f - (1.0f - t) * (1.0f - t);
+				break;
+			case kWarpEaseInOut:
+				warped = t * t * (3.0f - 2.0f * t);
+				break;
+			case kWarpPower:
+				// symmetric about the centre of the pad
+				warped = t < 0.5f ? 0.5f * std::pow(2.0f * t, power) : 1.0f - 0.5f * std::pow(2.0f - 2.0f * t, power);
+				break;
+			default:
+				warped = t;
+				break;
+			}
+			
+			table[i] = warped;
+		}
+	}
+	
+	static float lookupWarp(const float* table, const float t)
+	{
+		const float position = limit(t, 0.0f, 1.0f) * kWarpTableSize;
+		const int32_t index = std::min(static_cast<int32_t>(position), kWarpTableSize - 1);
+		const float frac = position - index;
+		return table[index] + frac * (table[index + 1] - table[index]);
+	}
+	
+	// Weights of the four corner scales for a position on the pad: warped bilinear
+	// interpolation, scaled by the corner gains and renormalised to sum to one
+	void cornerWeights(const float x, const float y, double* weights) const
+	{
+		const float u = lookupWarp(warp_table_x, (x - x_range_min) / x_size);
+		const float v = lookupWarp(warp_table_y, (y - y_range_min) / y_size);
+		
+		weights[0] = (1.0f - u) * v * fParameters[kParameterCornerGain1];
+		weights[1] = u * v * fParameters[kParameterCornerGain2];
+		weights[2] = (1.0f - u) * (1.0f - v) * fParameters[kParameterCornerGain3];
+		weights[3] = u * (1.0f - v) * fParameters[kParameterCornerGain4];
+		
+		const double sum = weights[0] + weights[1] + weights[2] + weights[3];
+		
+		if (sum > 1.0e-9)
+		{
+			for (int32_t c = 0; c < 4; c++)
+				weights[c] /= sum;
+		}
+		else
+		{
+			// every contributing corner muted: fall back to the ungained weights
+			weights[0] = (1.0f - u) * v;
+			weights[1] = u * v;
+			weights[2] = (1.0f - u) * (1.0f - v);
+			weights[3] = u * (1.0f - v);
+		}
+	}
+	
+	// Where the live blend's period starts and how many keys it spans, for the UI's
+	// library search: those of the corner weighing most at middle C. The snapshot's own
+	// table gives the period's size, so a blend of different periods is measured as it is.
+	void dominantPeriod(int32_t& root_note, int32_t& period_keys) const
+	{
+		int32_t dominant = 0;
+		
+		for (int32_t c = 1; c < 4; c++)
+		{
+			if (note_weights[c][kStretchCentreNote] > note_weights[dominant][kStretchCentreNote])
+				dominant = c;
+		}
+		
+		root_note = corner_root_note[dominant];
+		period_keys = corner_period_keys[dominant];
+	}
+	
+	// Rebuild the per-note corner weight field from the pad position and zone settings.
+	// Only called when one of those changes, so run() just reads the field.
+	void updateWeightField(const float x, const float y)
+	{
+		const int32_t zone_mode = static_cast<int32_t>(fParameters[kParameterZoneMode]);
+		
+		double zone_weights[4][4];
+		cornerWeights(x, y, zone_weights[0]);
+		cornerWeights(fParameters[kParameterZone2X], fParameters[kParameterZone2Y], zone_weights[1]);
+		cornerWeights(fParameters[kParameterZone3X], fParameters[kParameterZone3Y], zone_weights[2]);
+		cornerWeights(fParameters[kParameterZone4X], fParameters[kParameterZone4Y], zone_weights[3]);
+		
+		const float zone_starts[3] = {
+			fParameters[kParameterZone2Start],
+			fParameters[kParameterZone3Start],
+			fParameters[kParameterZone4Start]
+		};
+		
+		const float gradient_low = fParameters[kParameterGradientLow];
+		const float gradient_high = std::max(fParameters[kParameterGradientHigh], gradient_low + 1.0f);
+		
+		for (int32_t i = 0; i < 128; i++)
+		{
+			double weights[4];
+			
+			if (zone_mode == kZoneModeZones)
+			{
+				// Each zone runs from its start note up to the next zone's start
+				int32_t zone = 0;
+				for (int32_t z = 0; z < 3; z++)
+				{
+					if (i >= zone_starts[z])
+						zone = z + 1;
+				}
+				std::copy(zone_weights[zone], zone_weights[zone] + 4, weights);
+			}
+			else if (zone_mode == kZoneModeGradient)
+			{
+				// Low register at the pad position, high register at zone 2's position
+				const float t = limit((i - gradient_low) / (gradient_high - gradient_low), 0.0f, 1.0f);
+				cornerWeights(x + t * (fParameters[kParameterZone2X] - x), y + t * (fParameters[kParameterZone2Y] - y), weights);
+			}
+			else
+			{
+				std::copy(zone_weights[0], zone_weights[0] + 4, weights);
+			}
+			
+			for (int32_t c = 0; c < 4; c++)
+			{
+				note_weights[c][i] = weights[c];
+			}
+		}
+		
+		weights_x = x;
+		weights_y = y;
+		weights_dirty = false;
+	}
+	
+	// Rebuild the atlas blend for a pad position. The atlas spans the whole pad, with
+	// its [-1, 1] square stretched over the X and Y ranges.
+	void updateAtlasTable(const ScaleAtlas& atlas, const float x, const float y)
+	{
+		const float u = 2.0f * (x - x_range_min) / x_size - 1.0f;
+		const float v = 2.0f * (y - y_range_min) / y_size - 1.0f;
+		const uint32_t neighbours = static_cast<uint32_t>(std::lround(fParameters[kParameterAtlasNeighbours]));
+		
+		atlas.blendTable(u, v, neighbours, atlas_table);
+		
+		// octave stretch about the blend's own middle C, as for the corners
+		const double stretch = fParameters[kParameterOctaveStretch] / 1200.0;
+		
+		if (stretch != 0.0)
+		{
+			double stretched[128];
+			
+			for (int32_t i = 0; i < 128; i++)
+			{
+				stretched[i] = atlas_table[i] * std::exp2(stretch * stretchOctaves(atlas_table, i));
+			}
+			
+			std::copy(stretched, stretched + 128, atlas_table);
+		}
+		
+		// the nearest scale sets the period for the UI's library search
+		uint32_t row = 0;
+		float distance = 0.0f;
+		atlas_period_keys = atlas.nearest(u, v, 1, &row, &distance) > 0 ? std::max(1, static_cast<int32_t>(atlas.getNoteCount(row))) : 12;
+		
+		atlas_generation = atlas.getGeneration();
+		atlas_x = x;
+		atlas_y = y;
+		atlas_dirty = false;
+	}
+	
+	// Rebuild the sorted grid of pitches (cents above the grid's degree 0, one period)
+	// that the blended output can be snapped to. Entries past the period are padded
+	// with a large value so the fixed-step search in run() needs no bounds checks.
+	void updateGrid()
+	{
+		const int32_t count = std::min(static_cast<int32_t>(grid_tuning->tuning.scale.tones.size()), kGridSize - 1);
+		
+		grid_period_cents = grid_tuning->tuning.scale.tones.empty() ? 1200.0 : grid_tuning->tuning.scale.tones.back().cents;
+		
+		if (!(grid_period_cents > 0.0))
+			grid_period_cents = 1200.0;
+		
+		grid_cents[0] = 0.0;
+		
+		for (int32_t i = 1; i < count; i++)
+		{
+			grid_cents[i] = std::fmod(grid_tuning->tuning.scale.tones[i - 1].cents, grid_period_cents);
+			if (grid_cents[i] < 0.0)
+				grid_cents[i] += grid_period_cents;
+		}
+		
+		std::sort(grid_cents, grid_cents + std::max(count, 1));
+		
+		// the next period's degree 0 closes the grid
+		grid_cents[std::max(count, 1)] = grid_period_cents;
+		
+		for (int32_t i = std::max(count, 1) + 1; i <= kGridSize; i++)
+		{
+			grid_cents[i] = 1.0e30;
+		}
+		
+		grid_reference_hz = grid_tuning->tuning.frequencyForMidiNote(grid_tuning->tuning.keyboardMapping.middleNote);
+	}
+	
+	// Keyswitch notes select a slot (base note for the live scale space, then one note per slot).
+	// Returns true if the event was a keyswitch and should not be treated as a played note.
+	bool handleKeyswitch(const MidiEvent & event)
+	{
+		if (fParameters[kParameterKeyswitchEnable] < 0.5f or event.size > MidiEvent::kDataSize or event.size < 3)
+			return false;
+		
+		const uint8_t status = event.data[0] & 0xF0;
+		
+		if (status != 0x90 and status != 0x80)
+			return false;
+		
+		const int32_t slot = event.data[1] - static_cast<int32_t>(fParameters[kParameterKeyswitchBase]);
+		
+		if (slot < 0 or slot > kSlotCount)
+			return false;
+		
+		if (status == 0x90 and event.data[2] != 0)
+			pending_slot = slot;
+		
+		return true;
+	}
+	
+	// Pad position from MIDI CC, with optional 14-bit control through the matching LSB
+	// controllers. Unlike parameter changes these arrive with their frame, so each one
+	// becomes a point that run() splits the block at. Returns true if the event was used.
+	bool handlePadEvent(const MidiEvent & event, const uint32_t frames)
+	{
+		if (event.size > MidiEvent::kDataSize or event.size < 3 or (event.data[0] & 0xF0) != 0xB0)
+			return false;
+		
+		const uint8_t controller = event.data[1];
+		const uint8_t coarse = controller < 32 ? controller : controller - 32;
+		
+		if (controller >= 64 or (coarse != kPadControllerX and coarse != kPadControllerY))
+			return false;
+		
+		const int32_t axis = coarse - kPadControllerX;
+		const uint8_t value = event.data[2] & 0x7F;
+		
+		if (controller < 32)
+		{
+			// a new MSB starts without fine control, and its top value still reaches the edge
+			pad_msb[axis] = value;
+			pad_lsb[axis] = value == 127 ? 127 : 0;
+		}
+		else
+		{
+			pad_lsb[axis] = value;
+		}
+		
+		const float position = (pad_msb[axis] * 128 + pad_lsb[axis]) / 16383.0f;
+		
+		if (axis == 0)
+			pad_x = x_range_min + position * x_size;
+		else
+			pad_y = y_range_min + position * y_size;
+		
+		// Points are kept in frame order and inside the block. Points on the same frame
+		// collapse into one, and once the list is full the last point takes the newest value.
+		const uint32_t previous = pad_point_count > 0 ? pad_points[pad_point_count - 1].frame : 0;
+		const uint32_t frame = std::max(previous, std::min(event.frame, frames > 0 ? frames - 1 : 0));
+		
+		if (pad_point_count > 0 and (frame == previous or pad_point_count == kMaxPadPoints))
+			pad_points[pad_point_count - 1] = { frame, pad_x, pad_y };
+		else
+			pad_points[pad_point_count++] = { frame, pad_x, pad_y };
+		
+		return true;
+	}
+	
+	// Track held notes from incoming MIDI. Returns true if the set of held notes changed.
+	bool handleMidiEvent(const MidiEvent & event)
+	{
+		if (event.size > MidiEvent::kDataSize or event.size < 3)
+			return false;
+		
+		const uint8_t status = event.data[0] & 0xF0;
+		const uint8_t note = event.data[1] & 0x7F;
+		
+		const uint64_t bit = 1ULL << (note & 63);
+		
+		if (status == 0x90 and event.data[2] != 0)
+		{
+			if (held_notes[note] < 255)
+				held_notes[note]++;
+			held_mask[note >> 6] |= bit;
+			note_on_mask[note >> 6] |= bit;
+			return held_notes[note] == 1;
+		}
+		else if (status == 0x80 or status == 0x90)
+		{
+			if (held_notes[note] == 0)
+				return false;
+			held_notes[note]--;
+			if (held_notes[note] == 0)
+				held_mask[note >> 6] &= ~bit;
+			return held_notes[note] == 0;
+		}
+		else if (status == 0xB0 and (event.data[1] == 120 or event.data[1] == 123))
+		{
+			// All sound off / all notes off
+			std::memset(held_notes, 0, sizeof(held_notes));
+			held_mask[0] = held_mask[1] = 0;
+			return true;
+		}
+		
+		return false;
+	}
+	
+	// Rebuild the per-note just intonation field for the current chord.
+	// Bounded work (two passes over 128 notes) whatever the number of held notes.
+	void updateJustIntonationField()
+	{
+		uint16_t pitch_class_mask = 0;
+		
+		for (int32_t i = 0; i < 128; i++)
+		{
+			if (held_notes[i] > 0)
+				pitch_class_mask |= 1 << (i % 12);
+		}
 		
-		if (filename.endsWith(".scl"))
+		const int root_pitch_class = ji_lattice.rootForPitchClasses(pitch_class_mask);
+		
+		ji_root_note = -1;
+		
+		// The lowest held note of the root pitch class anchors the chord
+		for (int32_t i = 0; i < 128 and root_pitch_class >= 0; i++)
 		{
-			try
-			{   auto s = Tunings::readSCLFile(value);
-				tn = Tunings::Tuning(s, k);
-				//d_stdout("ScaleSpace: tuning set to %s", value);
+			if (held_notes[i] > 0 and i % 12 == root_pitch_class)
+			{
+				ji_root_note = i;
+				break;
 			}
-			catch (const std::exception& e)
+		}
+		
+		for (int32_t i = 0; i < 128; i++)
+		{
+			const bool in_chord = ji_root_note >= 0 and (pitch_class_mask & (1 << (i % 12)));
+			ji_weight[i] = in_chord ? 1.0 : 0.0;
+			ji_ratio[i] = in_chord ? ji_lattice.ratioForInterval(i - ji_root_note) : 1.0;
+		}
+	}
+	
+	// Turn the latest pitch estimate into a target position on the XY pad
+	void updateTrackingTarget(const int32_t mode)
+	{
+		const double pitch = pitch_detector.getFrequency();
+		
+		fParameters[kParameterDetectedPitch] = static_cast<float>(pitch);
+		
+		// Unpitched or silent input leaves the last target in place
+		if (pitch <= 0.0)
+			return;
+		
+		if (mode == kTrackingPitchClass)
+		{
+			// Pitch classes sit around the circle of fifths, C at the top
+			const int32_t note = static_cast<int32_t>(std::lround(69.0 + 12.0 * std::log2(pitch / 440.0)));
+			const int32_t fifths = ((note % 12 + 12) % 12) * 7 % 12;
+			const double angle = 2.0 * M_PI * fifths / 12.0;
+			
+			tracked_target_x = static_cast<float>(std::sin(angle)) * x_range_max;
+			tracked_target_y = static_cast<float>(std::cos(angle)) * y_range_max;
+		}
+		else if (mode == kTrackingCorner)
+		{
+			// Move to the corner whose scale has the note closest to the played pitch
+			int32_t best_corner = 0;
+			double best_error = 0.0;
+			
+			const double (*corners)[128] = cornerTables();
+			
+			for (int32_t c = 0; c < 4; c++)
 			{
-				tn = Tunings::Tuning();
-				d_stdout("ScaleSpace:Exception when setting tuning");
-				d_stdout(e.what());
+				double error = 1.0e9;
+				
+				for (int32_t i = 0; i < 128; i++)
+				{
+					const double ratio = corners[c][i] / pitch;
+					error = std::min(error, std::max(ratio, 1.0 / ratio));
+				}
+				
+				if (c == 0 or error < best_error)
+				{
+					best_corner = c;
+					best_error = error;
+				}
 			}
+			
+			// Scale 1 top left, 2 top right, 3 bottom left, 4 bottom right
+			tracked_target_x = (best_corner % 2 == 0) ? x_range_min : x_range_max;
+			tracked_target_y = (best_corner < 2) ? y_range_max : y_range_min;
 		}
-		else
+	}
+	
+	// Start or stop preview voices when the preview mode or chord root changes
+	void updatePreviewMode()
+	{
+		const int32_t mode = static_cast<int32_t>(fParameters[kParameterPreviewMode]);
+		const int32_t root = static_cast<int32_t>(fParameters[kParameterPreviewChordRoot]);
+		
+		if (mode == preview_mode and (mode != kPreviewChord or root == preview_chord_root))
+			return;
+		
+		preview_voices.allNotesOff();
+		
+		if (mode == kPreviewMidi)
 		{
-			auto s = Tunings::Tuning().scale;
-			tn = Tunings::Tuning(s, k);
-			//d_stdout("ScaleSpace: tuning scl reset");
+			// pick up notes that are already held
+			for (uint32_t i = 0; i < 128; i++)
+			{
+				if (held_notes[i] > 0)
+					preview_voices.noteOn(i, 100);
+			}
+		}
+		else if (mode == kPreviewChord)
+		{
+			for (uint32_t n = 0; n < sizeof(kPreviewChordKeys) / sizeof(kPreviewChordKeys[0]); n++)
+				preview_voices.noteOn(limit(root + kPreviewChordKeys[n], 0, 127), 100);
 		}
+		
+		preview_mode = mode;
+		preview_chord_root = root;
 	}
 	
-	void loadKbm(Tunings::Tuning & tn, const char* value)
+	void handlePreviewEvent(const MidiEvent & event)
 	{
-		String filename(value);
-		auto s = tn.scale;
-		if (filename.endsWith(".kbm"))
+		if (event.size > MidiEvent::kDataSize or event.size < 3)
+			return;
+		
+		const uint8_t status = event.data[0] & 0xF0;
+		const uint8_t note = event.data[1] & 0x7F;
+		
+		if (status == 0x90 and event.data[2] != 0)
+			preview_voices.noteOn(note, event.data[2]);
+		else if (status == 0x80 or status == 0x90)
+			preview_voices.noteOff(note);
+		else if (status == 0xB0 and (event.data[1] == 120 or event.data[1] == 123))
+			preview_voices.allNotesOff();
+	}
+	
+	static void clearOutputs(float** outputs, const uint32_t frames)
+	{
+		if (outputs == nullptr)
+			return;
+		
+		for (uint32_t c = 0; c < DISTRHO_PLUGIN_NUM_OUTPUTS; c++)
 		{
-			try
+			if (outputs[c] != nullptr)
+				std::memset(outputs[c], 0, sizeof(float) * frames);
+		}
+	}
+	
+	// Send MTS single note tuning SysEx for notes whose tuning changed since they were last sent.
+	// Output is limited to the bandwidth of a DIN MIDI link and to one message per block;
+	// held notes go first, then the remaining notes round-robin so none are starved.
+	void sendTuningSysex(const uint32_t frames)
+	{
+		sysex_budget = std::min(sysex_budget + frames * MtsSysex::kDinBytesPerSecond / sampleRate,
+		                        static_cast<double>(MtsSysex::kMaxMessageBytes));
+		
+		MtsSysex::frequenciesToWords(target_frequencies_in_hz, sysex_words);
+		
+		uint64_t pending[2];
+		changedNoteMask(sysex_words, sysex_sent_words, pending);
+		
+		if ((pending[0] | pending[1]) == 0)
+			return;
+		
+		if (sysex_budget < MtsSysex::kHeaderBytes + MtsSysex::kBytesPerNote)
+			return;
+		
+		const uint32_t max_notes = std::min(MtsSysex::kMaxNotesPerMessage,
+		                                    static_cast<uint32_t>((sysex_budget - MtsSysex::kHeaderBytes) / MtsSysex::kBytesPerNote));
+		
+		uint8_t notes[MtsSysex::kMaxNotesPerMessage];
+		uint32_t count = 0;
+		
+		for (uint32_t i = 0; i < 128 and count < max_notes; i++)
+		{
+			if (held_notes[i] > 0 and (pending[i >> 6] >> (i & 63)) & 1)
 			{
-				auto k = Tunings::readKBMFile(value);
-				tn = Tunings::Tuning(s, k);
-				//d_stdout("ScaleSpace: tuning set to %s", value);
+				notes[count++] = static_cast<uint8_t>(i);
+				pending[i >> 6] &= ~(1ULL << (i & 63));
 			}
-			catch (const std::exception& e)
+		}
+		
+		for (uint32_t k = 0; k < 128 and count < max_notes; k++)
+		{
+			const uint32_t i = (sysex_cursor + k) & 127;
+			
+			if ((pending[i >> 6] >> (i & 63)) & 1)
 			{
-				tn = Tunings::Tuning();
-				d_stdout("ScaleSpace:Exception when setting tuning");
-				d_stdout(e.what());
+				notes[count++] = static_cast<uint8_t>(i);
+				sysex_cursor = static_cast<uint8_t>((i + 1) & 127);
 			}
 		}
-		else
+		
+		const uint32_t size = MtsSysex::buildMessage(static_cast<uint8_t>(fParameters[kParameterSysexDevice]), 0,
+		                                             notes, count, sysex_words, sysex_buffer);
+		
+		MidiEvent event;
+		event.frame = 0;
+		event.size = size;
+		event.dataExt = sysex_buffer;
+		
+		if (!writeMidiEvent(event))
+			return;
+		
+		sysex_budget -= size;
+		
+		for (uint32_t n = 0; n < count; n++)
 		{
-			auto k = Tunings::Tuning().keyboardMapping;
-			tn = Tunings::Tuning(s, k);
-			//d_stdout("ScaleSpace: tuning kbm reset");
+			sysex_sent_words[notes[n]] = sysex_words[notes[n]];
 		}
 	}
 	
+	// Bit test rather than std::isfinite, which fast-math builds are free to fold away
+	static inline bool isFiniteFrequency(const double freq)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &freq, sizeof(bits));
+		return (bits & 0x7FF0000000000000ULL) != 0x7FF0000000000000ULL;
+	}
+	
 	void saveScale(const char* value)
 	{
 		// Use DPF's String to check for valid path
@@ -431,74 +2029,681 @@ protected:
     
     void activate() override
     {
-	    if (MTS_CanRegisterMaster())
-			MTS_RegisterMaster();
+		// Only one instance can be the MTS-ESP master; any other stays passive until the slot frees up
+		MasterTakeover::instance().request(&is_master);
+		was_master = false;
+		fParameters[kParameterPassive] = is_master ? 0.0f : 1.0f;
+		
+		tuning_log.activate(sampleRate);
+		
+		// make sure the first block publishes the whole table
+		mts_published = false;
+		deadband_open = false;
+		suppressed_updates = 0;
+		publish_countdown = 0.0;
+		rate_publishes = 0;
+		rate_frames = 0;
 	}
 	
     void deactivate() override
     {
-        MTS_DeregisterMaster();
+        // never deregister another instance's master slot
+        MasterTakeover::instance().withdraw(&is_master);
+        
+        if (is_master)
+            MTS_DeregisterMaster();
+        
+        is_master = false;
+        tuning_log.deactivate();
     }
     
    /* --------------------------------------------------------------------------------------------------------
     * Audio/MIDI Processing */
 
    /**
-      Run/process function for plugins without MIDI input.
+      Run/process function for plugins with MIDI input.
       @note Some parameters might be null if there are no audio inputs or outputs.
     */
-    void run(const float** inputs, float** outputs, uint32_t frames) override
+    void run(const float** inputs, float** outputs, uint32_t frames, const MidiEvent* midiEvents, uint32_t midiEventCount) override
     {
+		bool chord_changed = false;
+		
+		updatePreviewMode();
+		
+		pad_point_count = 0;
+		
+		for (uint32_t i = 0; i < midiEventCount; i++)
+		{
+			if (handleKeyswitch(midiEvents[i]) or handlePadEvent(midiEvents[i], frames))
+				continue;
+			
+			chord_changed |= handleMidiEvent(midiEvents[i]);
 			
+			if (preview_mode == kPreviewMidi)
+				handlePreviewEvent(midiEvents[i]);
+		}
+		
+		if (chord_changed)
+			updateJustIntonationField();
+		
+		// The takeover thread may have made this instance the master since the last block
+		const bool master = is_master.load(std::memory_order_acquire);
+		
+		if (master != was_master)
+		{
+			was_master = master;
+			mts_published = false;
+		}
+		
+		fParameters[kParameterPassive] = master ? 0.0f : 1.0f;
+		
+		// Passive instance: keep MIDI state current for a takeover, and only do the tuning
+		// work when SysEx output, the preview voices or the UI's library search need it;
+		// MTS-ESP is left to the master
+		const bool sysex_output = fParameters[kParameterSysexOutput] > 0.5f;
+		const bool preview_output = preview_mode != kPreviewOff or preview_voices.isActive();
+		
+		if (!master and !sysex_output and !preview_output and !editor_link->isSnapshotRequested())
+		{
+			// no tracking here, so the editor draws the atlas blend at the pad position
+			fParameters[kParameterTrackedX] = pad_x;
+			fParameters[kParameterTrackedY] = pad_y;
+			note_on_mask[0] = note_on_mask[1] = 0;
+			clearOutputs(outputs, frames);
+			return;
+		}
+		
+		// Pitch tracking from the audio input steers the pad position
+		const int32_t tracking_mode = static_cast<int32_t>(fParameters[kParameterTrackingMode]);
+		
+		if (tracking_mode != kTrackingOff and inputs != nullptr and inputs[0] != nullptr)
+		{
+			pitch_detector.process(inputs[0], frames);
+			
+			if (pitch_detector.hasNewEstimate())
+				updateTrackingTarget(tracking_mode);
+			
+			// Short glide towards the tracked target
+			const float glide = 1.0f - std::exp(-static_cast<float>(frames) / (sampleRate * kTrackingGlideSeconds));
+			tracked_x += (tracked_target_x - tracked_x) * glide;
+			tracked_y += (tracked_target_y - tracked_y) * glide;
+		}
+		else
+		{
+			tracked_x = tracked_target_x = pad_x;
+			tracked_y = tracked_target_y = pad_y;
+			fParameters[kParameterDetectedPitch] = 0.0f;
+		}
+		
+		fParameters[kParameterTrackedX] = tracked_x;
+		fParameters[kParameterTrackedY] = tracked_y;
+		
 		// Calculated weighted average of the four scales, and set target frequencies 
 		
 		double freq_increment[128];
-		double frame_count =  static_cast<double>(frames);
-
-		for (uint32_t i = 0; i < 128; i++)
+		
+		if (warp_dirty)
+		{
+			buildWarpTable(static_cast<int32_t>(fParameters[kParameterWarpX]), fParameters[kParameterWarpPower], warp_table_x);
+			buildWarpTable(static_cast<int32_t>(fParameters[kParameterWarpY]), fParameters[kParameterWarpPower], warp_table_y);
+			warp_dirty = false;
+		}
+		
+		// Generated corners are rebuilt here at control rate whenever a generator parameter moves
+		for (int32_t c = 0; c < 4; c++)
+		{
+			if (generator_dirty[c])
+			{
+				generator_dirty[c] = false;
+				updateGeneratedTable(c);
+			}
+		}
+		
+		if (alignment_dirty)
 		{
-			double freq1_c = tuning1.frequencyForMidiNote(i) * (0.5f - (fParameters[kParameterX] / x_size)) * (0.5f + (fParameters[kParameterY] / y_size));
-			double freq2_c = tuning2.frequencyForMidiNote(i) * (0.5f + (fParameters[kParameterX] / x_size)) * (0.5f + (fParameters[kParameterY] / y_size));
-			double freq3_c = tuning3.frequencyForMidiNote(i) * (0.5f - (fParameters[kParameterX] / x_size)) * (0.5f - (fParameters[kParameterY] / y_size));
-			double freq4_c = tuning4.frequencyForMidiNote(i) * (0.5f + (fParameters[kParameterX] / x_size)) * (0.5f - (fParameters[kParameterY] / y_size));
+			for (int32_t c = 0; c < 4; c++)
+				updateAlignedTable(c);
+			alignment_dirty = false;
+		}
+		
+		if (stretch_dirty)
+		{
+			updateStretchTable();
+			stretch_dirty = false;
+		}
+		
+		// Per-corner transpose and the global reference trim fold into one factor per corner
+		double corner_scale[4];
+		for (int32_t c = 0; c < 4; c++)
+		{
+			corner_scale[c] = std::exp2((fParameters[kParameterTranspose1 + c] + fParameters[kParameterReferenceTrim]) / 1200.0);
+		}
+		
+		const double (*corners)[128] = cornerTables();
+		
+		// Scale atlas: the pad blends the library scales nearest the puck instead of the corners
+		const ScaleAtlas& atlas = *scale_atlas.acquire();
+		const bool atlas_active = fParameters[kParameterAtlasEnable] > 0.5f and atlas.getCount() > 0;
+		const double reference_scale = std::exp2(fParameters[kParameterReferenceTrim] / 1200.0);
+		
+		auto liveBlend = [&](const uint32_t i)
+		{
+			if (atlas_active)
+				return atlas_table[i] * reference_scale;
 			
-			target_frequencies_in_hz[i] = freq1_c + freq2_c + freq3_c + freq4_c;
+			return corners[0][i] * corner_scale[0] * stretch_table[0][i] * note_weights[0][i]
+			     + corners[1][i] * corner_scale[1] * stretch_table[1][i] * note_weights[1][i]
+			     + corners[2][i] * corner_scale[2] * stretch_table[2][i] * note_weights[2][i]
+			     + corners[3][i] * corner_scale[3] * stretch_table[3][i] * note_weights[3][i];
+		};
+		
+		// Keyswitched slots: the live blend or a prebuilt slot table, crossfaded from
+		// whatever was sounding when the switch arrived
+		const SlotTable* slot = active_slot > 0 ? slot_tables[active_slot - 1].acquire() : nullptr;
+		const double* slot_table = slot != nullptr ? slot->frequencies : nullptr;
+		double fade = crossfade_position;
+		
+		// Slot tables take the reference trim and octave stretch at play time, like the corners
+		const double octave_stretch = fParameters[kParameterOctaveStretch] / 1200.0;
+		
+		auto slotBlend = [&](const uint32_t i)
+		{
+			return slot_table[i] * reference_scale * std::exp2(octave_stretch * slot->stretch_octaves[i]);
+		};
+		
+		auto blend = [&](const uint32_t i)
+		{
+			const double target = slot_table != nullptr ? slotBlend(i) : liveBlend(i);
+			return crossfade_from[i] * (1.0 - fade) + target * fade;
+		};
+		
+		if (pending_slot >= 0)
+		{
+			if (pending_slot != active_slot)
+			{
+				for (uint32_t i = 0; i < 128; i++)
+				{
+					// a non-finite snapshot would never fade out, so keep the published value instead
+					const double current = blend(i);
+					crossfade_from[i] = (isFiniteFrequency(current) and current > 0.0) ? current : frequencies_in_hz[i];
+				}
+				
+				active_slot = pending_slot;
+				slot = active_slot > 0 ? slot_tables[active_slot - 1].acquire() : nullptr;
+				slot_table = slot != nullptr ? slot->frequencies : nullptr;
+				crossfade_position = 0.0;
+			}
 			
-			freq_increment[i] = (target_frequencies_in_hz[i] - frequencies_in_hz[i]) * (1.0 / frame_count);
+			pending_slot = -1;
+		}
+		
+		const double crossfade_samples = fParameters[kParameterCrossfadeTime] * 0.001 * sampleRate;
+		crossfade_position = crossfade_samples > 1.0 ? std::min(1.0, crossfade_position + frames / crossfade_samples) : 1.0;
+		fade = crossfade_position;
+		
+		fParameters[kParameterActiveSlot] = static_cast<float>(active_slot);
+		
+		// Adaptive JI pulls chord tones towards just ratios above the blended root
+		const double ji_amount = fParameters[kParameterJustIntonation];
+		
+		// Optional snapping to the grid scale, mixed in the log domain
+		const double grid_strength = fParameters[kParameterGridStrength];
+		const bool grid_enabled = grid_strength > 0.0;
+		
+		// Hold mode: notes that are sounding keep their published frequency, and pick up
+		// the current value only when they are struck again
+		const bool hold_notes = fParameters[kParameterHoldNotes] > 0.5f;
+		
+		// Pinned notes ignore the blend, JI and grid
+		const NoteOverrides& overrides = *note_overrides.acquire();
+		
+		// Deadband: small moves are not published. Publishing starts once any note leaves the
+		// deadband around the published table, and stops once every note is back inside half of it.
+		const double deadband_cents = fParameters[kParameterDeadband];
+		
+		// Update scheduler: while the pad moves, or with no MTS-ESP clients connected, glides
+		// are published in steps of update_interval frames, counted across blocks so the rate
+		// holds at any block size. The step rate follows pad velocity, and is the idle rate with
+		// no clients. Any other change (notes, slots, generators, pins, files) ends the segment on
+		// its target, as does the end of a pad move.
+		const int num_clients = MTS_GetNumClients();
+		const double block_seconds = frames / static_cast<double>(sampleRate);
+		
+		if (block_seconds > 0.0)
+		{
+			const double distance = std::hypot((tracked_x - velocity_x) / x_size, (tracked_y - velocity_y) / y_size);
+			const double smoothing = 1.0 - std::exp(-block_seconds / kVelocitySmoothingSeconds);
+			pad_velocity += (distance / block_seconds - pad_velocity) * smoothing;
 		}
 		
-		// smoothing
-		for (uint32_t fr = 0; fr < frames; ++fr)
+		// where the previous segment left the pad
+		float segment_x = velocity_x;
+		float segment_y = velocity_y;
+		
+		velocity_x = tracked_x;
+		velocity_y = tracked_y;
+		
+		const double update_rate = num_clients > 0 ? std::min(kMaxUpdateRate, kIdleUpdateRate + pad_velocity * kUpdateRatePerVelocity) : kIdleUpdateRate;
+		const uint32_t update_interval = std::max(1u, static_cast<uint32_t>(sampleRate / update_rate));
+		uint32_t publish_count = 0;
+		
+		const bool log_enabled = fParameters[kParameterLogEnable] > 0.5f;
+		tuning_log.setEnabled(log_enabled);
+		
+		uint32_t replaced_notes = 0;
+		uint32_t clamped_notes = 0;
+		
+		// Segments: each pad point sent as MIDI CC in this block ends a segment, which glides
+		// to that position by the point's frame; the last segment runs to the end of the block.
+		// Pitch tracking drives the position itself, so it always runs as one segment.
+		const uint32_t segments = tracking_mode == kTrackingOff ? pad_point_count + 1 : 1;
+		uint32_t segment_start = 0;
+		
+		for (uint32_t s = 0; s < segments; s++)
 		{
+			const bool final_segment = s + 1 == segments;
+			const uint32_t segment_end = final_segment ? frames : pad_points[s].frame;
+			const uint32_t segment_frames = segment_end - segment_start;
+			const float x = final_segment ? tracked_x : pad_points[s].x;
+			const float y = final_segment ? tracked_y : pad_points[s].y;
+			
+			// a point at the start of a segment just moves the position the next one glides to
+			if (segment_frames == 0 and !final_segment)
+				continue;
+			
+			const bool throttled = num_clients == 0 or x != segment_x or y != segment_y;
+			segment_x = x;
+			segment_y = y;
+			
+			replaced_notes = 0;
+			clamped_notes = 0;
+			
+			const double frame_count = static_cast<double>(segment_frames);
+			
+			if (weights_dirty or x != weights_x or y != weights_y)
+				updateWeightField(x, y);
+			
+			if (atlas_active and (atlas_dirty or atlas.getGeneration() != atlas_generation or x != atlas_x or y != atlas_y))
+				updateAtlasTable(atlas, x, y);
+			
+			const double ji_root_frequency = ji_root_note >= 0 ? blend(ji_root_note) : 0.0;
+			
+			// Notes struck since the last publish jump straight to their new frequency
+			const uint64_t snap_mask[2] = { hold_notes ? note_on_mask[0] : 0, hold_notes ? note_on_mask[1] : 0 };
+			const uint64_t frozen_mask[2] = { hold_notes ? held_mask[0] & ~snap_mask[0] : 0, hold_notes ? held_mask[1] & ~snap_mask[1] : 0 };
+			
+			// Blend and sanitise in one branch-free pass so the compiler can vectorise it.
+			// Zero, negative or non-finite results fall back to the last published (always valid)
+			// frequency, and anything else is clamped to the range MTS-ESP clients can handle.
 			for (uint32_t i = 0; i < 128; i++)
 			{
-				if (fr == frames - 1)
+				double blended = blend(i);
+				blended += ji_amount * ji_weight[i] * (ji_root_frequency * ji_ratio[i] - blended);
+				
+				if (grid_enabled)
+				{
+					const double cents = 1200.0 * std::log2(blended / grid_reference_hz);
+					const double period_start = std::floor(cents / grid_period_cents) * grid_period_cents;
+					const double position = cents - period_start;
+					
+					// Branch-free binary search for the last grid entry at or below position
+					int32_t base = 0;
+					for (int32_t step = kGridSize / 2; step > 0; step >>= 1)
+					{
+						base = (grid_cents[base + step] <= position) ? base + step : base;
+					}
+					
+					const double below = grid_cents[base];
+					const double above = grid_cents[base + 1];
+					const double nearest = (position - below < above - position) ? below : above;
+					
+					blended *= std::exp2(grid_strength * (nearest - position) / 1200.0);
+				}
+				
+				const bool pinned = (overrides.mask[i >> 6] >> (i & 63)) & 1;
+				blended = pinned ? overrides.frequencies[i] : blended;
+				
+				const bool valid = isFiniteFrequency(blended) & (blended > 0.0);
+				const double good = valid ? blended : frequencies_in_hz[i];
+				const double clamped = std::min(std::max(good, kMinNoteFrequency), kMaxNoteFrequency);
+				
+				replaced_notes += !valid;
+				clamped_notes += (clamped != good);
+				
+				const bool frozen = (frozen_mask[i >> 6] >> (i & 63)) & 1;
+				target_frequencies_in_hz[i] = frozen ? frequencies_in_hz[i] : clamped;
+				glide_from[i] = frozen ? frequencies_in_hz[i] : glide_from[i];
+				
+				// the glide runs from the last segment's target to this one's over the segment
+				freq_increment[i] = (target_frequencies_in_hz[i] - glide_from[i]) * (1.0 / frame_count);
+			}
+			
+			// the UI's library search asked for the current tuning
+			if (final_segment and editor_link->isSnapshotRequested())
+			{
+				int32_t root_note = slot != nullptr ? slot->root_note : ScaleGenerator::kRootNote;
+				int32_t period_keys = slot != nullptr ? slot->period_keys : atlas_period_keys;
+				
+				if (slot == nullptr and !atlas_active)
+					dominantPeriod(root_note, period_keys);
+				
+				editor_link->publishSnapshot(target_frequencies_in_hz, root_note, period_keys);
+			}
+			
+			// Nothing to publish if no note moved since the last segment
+			uint64_t changed[2];
+			changedNoteMask(target_frequencies_in_hz, frequencies_in_hz, changed);
+			
+			if (deadband_cents > 0.0 and mts_published and (changed[0] | changed[1]) != 0 and (snap_mask[0] | snap_mask[1]) == 0)
+			{
+				const double threshold = deadband_open ? deadband_cents * kDeadbandRelease : deadband_cents;
+				const double upper = std::exp2(threshold / 1200.0);
+				const double lower = 1.0 / upper;
+				
+				uint32_t outside = 0;
+				for (uint32_t i = 0; i < 128; i++)
+				{
+					const double ratio = target_frequencies_in_hz[i] / frequencies_in_hz[i];
+					outside += (ratio > upper) | (ratio < lower);
+				}
+				
+				deadband_open = outside > 0;
+				
+				if (!deadband_open)
+				{
+					// keep the published table as the reference, so slow drifts still add up
+					std::copy(frequencies_in_hz, frequencies_in_hz + 128, target_frequencies_in_hz);
+					changed[0] = changed[1] = 0;
+					suppressed_updates++;
+				}
+			}
+			
+			// The first table, and notes struck in hold mode, go out at the start of the segment;
+			// otherwise the first publish waits for the next step of the schedule, or for the
+			// end of the segment when the change is not throttled
+			const bool publish_wanted = !mts_published or (changed[0] | changed[1]) != 0;
+			const bool publish_now = !mts_published or (snap_mask[0] | snap_mask[1]) != 0;
+			const bool end_on_target = publish_wanted and !throttled;
+			
+			if (publish_wanted and (publish_now or end_on_target or publish_countdown <= segment_frames))
+			{
+				for (uint32_t i = 0; i < 128; i++)
 				{
-					//ensure target met
-					frequencies_in_hz[i] = target_frequencies_in_hz[i];
+					if (!mts_published or ((snap_mask[i >> 6] >> (i & 63)) & 1))
+					{
+						glide_from[i] = target_frequencies_in_hz[i];
+						freq_increment[i] = 0.0;
+					}
 				}
-				else
+				
+				mts_published = true;
+				
+				// smoothing: publish points on the glide, each one exactly where the glide is at
+				// that frame, so a throttled glide that misses the end of the segment still lands on
+				// its target at the next point
+				uint32_t fr = publish_now ? 1 : static_cast<uint32_t>(std::max(1.0, std::ceil(publish_countdown)));
+				uint32_t last = 0;
+				
+				if (end_on_target)
+					fr = std::min(fr, segment_frames);
+				
+				while (fr <= segment_frames)
 				{
-					frequencies_in_hz[i] += freq_increment[i];
+					const double steps = static_cast<double>(fr);
+					
+					for (uint32_t i = 0; i < 128; i++)
+					{
+						if (fr == segment_frames)
+						{
+							//ensure target met
+							frequencies_in_hz[i] = target_frequencies_in_hz[i];
+						}
+						else
+						{
+							frequencies_in_hz[i] = glide_from[i] + freq_increment[i] * steps;
+						}
+					}
+					// Set MTS-ESP Scale
+					if (master)
+						MTS_SetNoteTunings(frequencies_in_hz);
+					
+					// every published table is logged at its own frame
+					if (log_enabled)
+						tuning_log.push(log_sample_time + segment_start + fr, frequencies_in_hz);
+					
+					publish_count++;
+					last = fr;
+					
+					if (fr == segment_frames)
+						break;
+					
+					fr = end_on_target ? std::min(fr + update_interval, segment_frames) : fr + update_interval;
 				}
+				
+				publish_countdown = static_cast<double>(last + update_interval - segment_frames);
+				
+				// struck notes have been published, so they are held from now on
+				note_on_mask[0] = note_on_mask[1] = 0;
 			}
-			// Set MTS-ESP Scale
-		    MTS_SetNoteTunings(frequencies_in_hz);
+			else
+			{
+				publish_countdown = std::max(0.0, publish_countdown - segment_frames);
+				
+				// with nothing to publish, struck notes already sound at their target
+				if (!publish_wanted)
+					note_on_mask[0] = note_on_mask[1] = 0;
+			}
+			
+			// the next segment's glide starts where this one's ends, published or not
+			std::copy(target_frequencies_in_hz, target_frequencies_in_hz + 128, glide_from);
+			
+			segment_start = segment_end;
+		}
+		
+		// Report the rate actually achieved, averaged over a short window
+		rate_publishes += publish_count;
+		rate_frames += frames;
+		
+		if (rate_frames >= sampleRate * kRateWindowSeconds)
+		{
+			fParameters[kParameterUpdateRate] = static_cast<float>(std::min(kMaxUpdateRate, rate_publishes * static_cast<double>(sampleRate) / rate_frames));
+			rate_publishes = 0;
+			rate_frames = 0;
+		}
+		
+		log_sample_time += frames;
+		
+		fParameters[kParameterReplacedNotes] = static_cast<float>(replaced_notes);
+		fParameters[kParameterClampedNotes] = static_cast<float>(clamped_notes);
+		fParameters[kParameterSuppressedUpdates] = static_cast<float>(suppressed_updates);
+		fParameters[kParameterLogDropped] = static_cast<float>(tuning_log.getDroppedCount());
+		
+		// Hardware synths get the same changes as MTS-ESP clients, over SysEx
+		if (sysex_output and !sysex_enabled)
+		{
+			// resend everything when output is switched on
+			std::memset(sysex_sent_words, 0xFF, sizeof(sysex_sent_words));
+		}
+		
+		sysex_enabled = sysex_output;
+		
+		if (sysex_output)
+			sendTuningSysex(frames);
+		
+		// Preview voices play at the tuning just computed. The input may share a buffer
+		// with the outputs, so they are only written now that pitch tracking is done.
+		clearOutputs(outputs, frames);
+		
+		if (preview_voices.isActive())
+		{
+			preview_voices.setFrequencies(target_frequencies_in_hz);
+			preview_voices.render(outputs[0], outputs[1], frames, fParameters[kParameterPreviewLevel]);
 		}
-   
     }
     
 
+   /**
+      Optional callback to inform the plugin about a sample rate change.
+    */
+    void sampleRateChanged(double newSampleRate) override
+    {
+        sampleRate = newSampleRate;
+        pitch_detector.setSampleRate(newSampleRate);
+        preview_voices.setSampleRate(newSampleRate);
+    }
+    
     // -------------------------------------------------------------------------------------------------------
 
 private:
     float sampleRate;
+    
+    // Parse results and tuning snapshots for the editor, found through EditorLinks by the
+    // id reported in kParameterEditorLink
+    std::shared_ptr<EditorLink> editor_link;
+    uint32_t editor_link_id;
 
     float fParameters[kParameterCount];
-    Tunings::Tuning tuning1, tuning2, tuning3, tuning4;
+    ScaleCache::Handle tuning1, tuning2, tuning3, tuning4;
     
     double frequencies_in_hz[128];
     double target_frequencies_in_hz[128];
+    double glide_from[128];     // start of the block's glide: the last block's target
+    double corner_frequencies_in_hz[4][128];
+    double file_frequencies_in_hz[4][128];
+    bool generator_dirty[4];
+    
+    // Key each corner's period starts on and keys per period, for the UI's library search
+    int32_t file_root_note[4];
+    int32_t file_period_keys[4];
+    int32_t corner_root_note[4];
+    int32_t corner_period_keys[4];
+    
+    // Octave stretch, per corner and note
+    static constexpr int32_t kStretchCentreNote = 60;
+    double stretch_table[4][128];
+    bool stretch_dirty;
+    double aligned_frequencies_in_hz[4][128];
+    bool alignment_dirty;
+    
+    // Per-note corner weights (keyboard zones and register gradients)
+    double note_weights[4][128];
+    bool weights_dirty;
+    float weights_x;
+    float weights_y;
+    
+    // Corner weight warp curves
+    static constexpr int32_t kWarpTableSize = 256;
+    float warp_table_x[kWarpTableSize + 1];
+    float warp_table_y[kWarpTableSize + 1];
+    bool warp_dirty;
+    
+    // Adaptive just intonation
+    JustIntonationLattice ji_lattice;
+    uint8_t held_notes[128];
+    uint64_t held_mask[2];
+    uint64_t note_on_mask[2];
+    double ji_weight[128];
+    double ji_ratio[128];
+    int32_t ji_root_note;
+    
+    // Audio input pitch tracking
+    static constexpr float kTrackingGlideSeconds = 0.05f;
+    PitchDetector pitch_detector;
+    float tracked_x;
+    float tracked_y;
+    float tracked_target_x;
+    float tracked_target_y;
+    
+    // Pad position from the X/Y parameters or MIDI CC, and the CC points of this block
+    static constexpr uint8_t kPadControllerX = 16;
+    static constexpr uint8_t kPadControllerY = 17;
+    static constexpr uint32_t kMaxPadPoints = 64;
+    struct PadPoint
+    {
+        uint32_t frame;
+        float x;
+        float y;
+    };
+    PadPoint pad_points[kMaxPadPoints];
+    uint32_t pad_point_count;
+    uint8_t pad_msb[2];
+    uint8_t pad_lsb[2];
+    float pad_x;
+    float pad_y;
+    
+    // Preview voices, and the reference chord as keys above its root
+    static constexpr int32_t kPreviewChordKeys[4] = { 0, 4, 7, 12 };
+    PreviewVoices preview_voices;
+    int32_t preview_mode;
+    int32_t preview_chord_root;
+    
+    // Keyswitched scale slots
+    ScaleCache::Handle slot_tunings[kSlotCount];
+    struct SlotTable
+    {
+        double frequencies[128];
+        double stretch_octaves[128];
+        int32_t root_note;
+        int32_t period_keys;
+    };
+    RealtimeHandoff<SlotTable> slot_tables[kSlotCount];
+    double crossfade_from[128];
+    double crossfade_position;
+    int32_t active_slot;
+    int32_t pending_slot;
+    
+    // Per-note overrides, handed to run() like the slot tables
+    RealtimeHandoff<NoteOverrides> note_overrides;
+    
+    // Scale atlas, handed to run() like the overrides, and its blend at the last pad
+    // position; atlas_generation identifies the atlas contents that blend came from
+    RealtimeHandoff<ScaleAtlas> scale_atlas;
+    uint64_t atlas_generation;
+    double atlas_table[128];
+    int32_t atlas_period_keys;
+    float atlas_x;
+    float atlas_y;
+    bool atlas_dirty;
+    
+    // Grid quantisation
+    static constexpr int32_t kGridSize = 256;
+    ScaleCache::Handle grid_tuning;
+    double grid_cents[kGridSize + 1];
+    double grid_period_cents;
+    double grid_reference_hz;
+    
+    // Master registration, granted by MasterTakeover; was_master is the audio thread's last view
+    std::atomic<bool> is_master;
+    bool was_master;
+    
+    // Published tables, logged to file from a writer thread
+    TuningLogWriter tuning_log;
+    uint64_t log_sample_time;
+    
+    // Publishing and MTS SysEx output
+    static constexpr double kDeadbandRelease = 0.5;
+    bool mts_published;
+    bool deadband_open;
+    uint32_t suppressed_updates;
+    
+    // Update scheduler
+    static constexpr double kIdleUpdateRate = 20.0;          // Hz, pad still or no clients
+    static constexpr double kMaxUpdateRate = 2000.0;         // Hz
+    static constexpr double kUpdateRatePerVelocity = 500.0;  // Hz per pad width per second
+    static constexpr double kVelocitySmoothingSeconds = 0.05;
+    static constexpr double kRateWindowSeconds = 0.5;
+    double pad_velocity;
+    float velocity_x;
+    float velocity_y;
+    double publish_countdown;   // frames until the next scheduled publish
+    uint32_t rate_publishes;
+    uint32_t rate_frames;
+    bool sysex_enabled;
+    double sysex_budget;
+    uint8_t sysex_cursor;
+    uint32_t sysex_words[128];
+    uint32_t sysex_sent_words[128];
+    uint8_t sysex_buffer[MtsSysex::kMaxMessageBytes];
     
     float x_range_min;
 	float x_range_max;
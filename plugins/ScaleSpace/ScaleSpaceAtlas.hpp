@@ -0,0 +1,658 @@
+#ifndef ScaleSpace_ATLAS_HPP
+#define ScaleSpace_ATLAS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ScaleSpaceGenerators.hpp"
+#include "ScaleSpaceLibrary.hpp"
+
+// Scale atlas: the whole library laid out on the XY pad by similarity. Each scale's
+// fingerprint is projected onto its first two principal components, so neighbouring
+// points sound alike, and the pad position blends the nearest scales.
+//
+// Atlas file layout (little endian): "SSAT", a version byte, u64 signature of the
+// library it was built from, u32 point count, then per point: f32 x, f32 y,
+// f32 period in cents, u16 note count, note count f32 tones, u16 length + path.
+// The file carries everything needed to blend, so the DSP loads it without the library.
+namespace ScaleAtlasFormat
+{
+    static constexpr char kMagic[4] = { 'S', 'S', 'A', 'T' };
+    static constexpr uint8_t kVersion = 1;
+
+    // Atlases are named after the library they were built from, so a file that exists
+    // for a signature is already that library's atlas, and editors showing different
+    // libraries never overwrite each other's file
+    static inline std::string atlasPath(const uint64_t library_signature)
+    {
+        char name[40];
+        std::snprintf(name, sizeof(name), "library-%016llx.ssatlas", static_cast<unsigned long long>(library_signature));
+        return (std::filesystem::path(ScaleLibrary::settingsFolder()) / name).string();
+    }
+
+    // Identifies a library's contents, so an atlas is only rebuilt when they change (64 bit FNV-1a)
+    static inline uint64_t signature(const std::vector<ScaleLibrary::Record>& records)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+
+        auto add = [&hash](const void* data, const size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+        };
+
+        for (const ScaleLibrary::Record& record : records)
+        {
+            add(record.path.data(), record.path.size());
+            add(record.fingerprint, sizeof(record.fingerprint));
+            add(record.tones.data(), record.tones.size() * sizeof(float));
+        }
+
+        return hash;
+    }
+
+    // Split [0, count) into one range per thread and run body(begin, end, thread)
+    template <class Body>
+    static inline void parallelFor(const uint32_t count, const uint32_t threads, Body body)
+    {
+        std::vector<std::thread> pool;
+
+        for (uint32_t t = 1; t < threads; t++)
+            pool.emplace_back(body, static_cast<uint32_t>(static_cast<uint64_t>(count) * t / threads),
+                              static_cast<uint32_t>(static_cast<uint64_t>(count) * (t + 1) / threads), t);
+
+        body(0, static_cast<uint32_t>(count / threads), 0);
+
+        for (std::thread& thread : pool)
+            thread.join();
+    }
+
+    // Largest eigenvector of the symmetric matrix by power iteration
+    static inline void principalAxis(const double* matrix, double* axis)
+    {
+        constexpr int32_t D = ScaleLibrary::kFingerprintSize;
+
+        for (int32_t i = 0; i < D; i++)
+            axis[i] = 1.0 / std::sqrt(static_cast<double>(D)) + 1.0e-3 * i;
+
+        for (int32_t iteration = 0; iteration < 200; iteration++)
+        {
+            double next[D];
+            double length = 0.0;
+
+            for (int32_t r = 0; r < D; r++)
+            {
+                next[r] = 0.0;
+
+                for (int32_t c = 0; c < D; c++)
+                    next[r] += matrix[r * D + c] * axis[c];
+
+                length += next[r] * next[r];
+            }
+
+            length = std::sqrt(length);
+
+            if (!(length > 0.0))
+                return;
+
+            for (int32_t i = 0; i < D; i++)
+                axis[i] = next[i] / length;
+        }
+
+        // A fixed sign, so rebuilding the same library gives the same layout
+        int32_t largest = 0;
+
+        for (int32_t i = 1; i < D; i++)
+        {
+            if (std::fabs(axis[i]) > std::fabs(axis[largest]))
+                largest = i;
+        }
+
+        if (axis[largest] < 0.0)
+        {
+            for (int32_t i = 0; i < D; i++)
+                axis[i] = -axis[i];
+        }
+    }
+
+    // Project every fingerprint onto the two principal components, scaled to fill [-1, 1].
+    // The mean, the covariance and the projection are each split across threads.
+    static inline void embed(const std::vector<ScaleLibrary::Record>& records, std::vector<float>& xs, std::vector<float>& ys, uint32_t threads = 0)
+    {
+        constexpr int32_t D = ScaleLibrary::kFingerprintSize;
+        const uint32_t count = static_cast<uint32_t>(records.size());
+
+        xs.assign(count, 0.0f);
+        ys.assign(count, 0.0f);
+
+        if (count < 2)
+            return;
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        threads = std::min(threads, count);
+
+        std::vector<double> partial_means(threads * D, 0.0);
+
+        parallelFor(count, threads, [&](const uint32_t begin, const uint32_t end, const uint32_t t)
+        {
+            double* const mean = &partial_means[t * D];
+
+            for (uint32_t i = begin; i < end; i++)
+            {
+                for (int32_t d = 0; d < D; d++)
+                    mean[d] += records[i].fingerprint[d];
+            }
+        });
+
+        double mean[D] = {};
+
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            for (int32_t d = 0; d < D; d++)
+                mean[d] += partial_means[t * D + d] / count;
+        }
+
+        std::vector<double> partial_covariances(threads * D * D, 0.0);
+
+        parallelFor(count, threads, [&](const uint32_t begin, const uint32_t end, const uint32_t t)
+        {
+            double* const covariance = &partial_covariances[t * D * D];
+            double centred[D];
+
+            for (uint32_t i = begin; i < end; i++)
+            {
+                for (int32_t d = 0; d < D; d++)
+                    centred[d] = records[i].fingerprint[d] - mean[d];
+
+                for (int32_t r = 0; r < D; r++)
+                {
+                    for (int32_t c = r; c < D; c++)
+                        covariance[r * D + c] += centred[r] * centred[c];
+                }
+            }
+        });
+
+        std::vector<double> covariance(D * D, 0.0);
+
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            for (int32_t r = 0; r < D; r++)
+            {
+                for (int32_t c = r; c < D; c++)
+                    covariance[r * D + c] += partial_covariances[t * D * D + r * D + c];
+            }
+        }
+
+        for (int32_t r = 0; r < D; r++)
+        {
+            for (int32_t c = 0; c < r; c++)
+                covariance[r * D + c] = covariance[c * D + r];
+        }
+
+        // First component, then the second from the covariance with the first removed
+        double axis_x[D];
+        double axis_y[D];
+        principalAxis(covariance.data(), axis_x);
+
+        double variance = 0.0;
+
+        for (int32_t r = 0; r < D; r++)
+        {
+            for (int32_t c = 0; c < D; c++)
+                variance += axis_x[r] * covariance[r * D + c] * axis_x[c];
+        }
+
+        for (int32_t r = 0; r < D; r++)
+        {
+            for (int32_t c = 0; c < D; c++)
+                covariance[r * D + c] -= variance * axis_x[r] * axis_x[c];
+        }
+
+        principalAxis(covariance.data(), axis_y);
+
+        std::vector<float> partial_extents(threads * 2, 0.0f);
+
+        parallelFor(count, threads, [&](const uint32_t begin, const uint32_t end, const uint32_t t)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                double x = 0.0;
+                double y = 0.0;
+
+                for (int32_t d = 0; d < D; d++)
+                {
+                    const double centred = records[i].fingerprint[d] - mean[d];
+                    x += centred * axis_x[d];
+                    y += centred * axis_y[d];
+                }
+
+                xs[i] = static_cast<float>(x);
+                ys[i] = static_cast<float>(y);
+                partial_extents[t * 2] = std::max(partial_extents[t * 2], std::fabs(xs[i]));
+                partial_extents[t * 2 + 1] = std::max(partial_extents[t * 2 + 1], std::fabs(ys[i]));
+            }
+        });
+
+        float extent_x = 0.0f;
+        float extent_y = 0.0f;
+
+        for (uint32_t t = 0; t < threads; t++)
+        {
+            extent_x = std::max(extent_x, partial_extents[t * 2]);
+            extent_y = std::max(extent_y, partial_extents[t * 2 + 1]);
+        }
+
+        const float scale_x = extent_x > 0.0f ? 1.0f / extent_x : 0.0f;
+        const float scale_y = extent_y > 0.0f ? 1.0f / extent_y : 0.0f;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            xs[i] *= scale_x;
+            ys[i] *= scale_y;
+        }
+    }
+
+    static inline bool readSignature(const std::string& path, uint64_t& value)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+
+        if (file == nullptr)
+            return false;
+
+        char magic[4];
+        int64_t bits = 0;
+        const bool ok = std::fread(magic, 1, 4, file) == 4 and std::memcmp(magic, kMagic, 4) == 0
+                        and std::fgetc(file) == kVersion and ScaleLibrary::readI64(file, bits);
+
+        std::fclose(file);
+        value = static_cast<uint64_t>(bits);
+        return ok;
+    }
+
+    static inline bool write(const std::string& path, const uint64_t library_signature, const std::vector<ScaleLibrary::Record>& records,
+                             const std::vector<float>& xs, const std::vector<float>& ys)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+        const std::string temporary = ScaleLibrary::temporaryPath(path);
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+
+        if (file == nullptr)
+            return false;
+
+        std::fwrite(kMagic, 1, 4, file);
+        std::fputc(kVersion, file);
+        ScaleLibrary::writeI64(file, static_cast<int64_t>(library_signature));
+        ScaleLibrary::writeU32(file, static_cast<uint32_t>(records.size()));
+
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const uint16_t note_count = static_cast<uint16_t>(std::min<size_t>(records[i].tones.size(), 65535));
+
+            ScaleLibrary::writeF32(file, xs[i]);
+            ScaleLibrary::writeF32(file, ys[i]);
+            ScaleLibrary::writeF32(file, records[i].period_cents);
+            ScaleLibrary::writeU16(file, note_count);
+
+            for (uint16_t t = 0; t < note_count; t++)
+                ScaleLibrary::writeF32(file, records[i].tones[t]);
+
+            ScaleLibrary::writeString(file, records[i].path);
+        }
+
+        const bool ok = std::ferror(file) == 0;
+        std::fclose(file);
+
+        if (!ok)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        // replaced in one step, so the DSP loading the file never finds it missing
+        return ScaleLibrary::replaceFile(temporary, path);
+    }
+}
+
+// A loaded atlas: the points, their tones, and a uniform grid over the pad so the
+// nearest points to the puck are found by looking at a few cells. Loading allocates;
+// nearest() and blendTable() do not, so the DSP can call them from run().
+class ScaleAtlas
+{
+public:
+    static constexpr int32_t kMaxNeighbours = 8;
+    static constexpr int32_t kGridCells = 32;
+
+    bool load(const char* path)
+    {
+        clear();
+        std::FILE* file = std::fopen(path, "rb");
+
+        if (file == nullptr)
+            return false;
+
+        char magic[4];
+        int64_t signature = 0;
+        uint32_t count = 0;
+        bool ok = std::fread(magic, 1, 4, file) == 4 and std::memcmp(magic, ScaleAtlasFormat::kMagic, 4) == 0
+                  and std::fgetc(file) == ScaleAtlasFormat::kVersion
+                  and ScaleLibrary::readI64(file, signature) and ScaleLibrary::readU32(file, count);
+
+        for (uint32_t i = 0; ok and i < count; i++)
+        {
+            float x = 0.0f;
+            float y = 0.0f;
+            float period = 0.0f;
+            uint16_t note_count = 0;
+            std::string path_text;
+
+            ok = ScaleLibrary::readF32(file, x) and ScaleLibrary::readF32(file, y)
+                 and ScaleLibrary::readF32(file, period) and ScaleLibrary::readU16(file, note_count);
+
+            first_tone.push_back(static_cast<uint32_t>(tones.size()));
+
+            for (uint16_t t = 0; ok and t < note_count; t++)
+            {
+                float cents = 0.0f;
+                ok = ScaleLibrary::readF32(file, cents);
+                tones.push_back(cents);
+            }
+
+            ok = ok and ScaleLibrary::readString(file, path_text);
+
+            xs.push_back(limit(x, -1.0f, 1.0f));
+            ys.push_back(limit(y, -1.0f, 1.0f));
+            periods.push_back(period);
+            note_counts.push_back(note_count);
+            paths.push_back(path_text);
+        }
+
+        std::fclose(file);
+
+        if (!ok)
+        {
+            clear();
+            return false;
+        }
+
+        buildGrid();
+        return true;
+    }
+
+    void clear()
+    {
+        xs.clear();
+        ys.clear();
+        periods.clear();
+        note_counts.clear();
+        first_tone.clear();
+        tones.clear();
+        paths.clear();
+        cell_start.clear();
+        cell_items.clear();
+        generation = nextGeneration();
+    }
+
+    uint32_t getCount() const { return static_cast<uint32_t>(xs.size()); }
+    uint64_t getGeneration() const { return generation; }
+    float getX(const uint32_t i) const { return xs[i]; }
+    float getY(const uint32_t i) const { return ys[i]; }
+    const std::string& getPath(const uint32_t i) const { return paths[i]; }
+    uint32_t getNoteCount(const uint32_t i) const { return note_counts[i]; }
+
+    // The k nearest points to (x, y), nearest first; returns how many were found
+    uint32_t nearest(const float x, const float y, uint32_t k, uint32_t* rows, float* distances) const
+    {
+        k = std::min<uint32_t>(std::min<uint32_t>(k, kMaxNeighbours), getCount());
+
+        if (k == 0)
+            return 0;
+
+        const int32_t cell_x = cellOf(x);
+        const int32_t cell_y = cellOf(y);
+        const float cell_size = 2.0f / kGridCells;
+        uint32_t found = 0;
+
+        // Widen the search ring by ring until nothing further out can be closer
+        for (int32_t ring = 0; ring < kGridCells; ring++)
+        {
+            for (int32_t cy = cell_y - ring; cy <= cell_y + ring; cy++)
+            {
+                if (cy < 0 or cy >= kGridCells)
+                    continue;
+
+                const bool edge_row = cy == cell_y - ring or cy == cell_y + ring;
+
+                for (int32_t cx = cell_x - ring; cx <= cell_x + ring; cx += (edge_row or ring == 0) ? 1 : 2 * ring)
+                {
+                    if (cx < 0 or cx >= kGridCells)
+                        continue;
+
+                    const int32_t cell = cy * kGridCells + cx;
+
+                    for (uint32_t item = cell_start[cell]; item < cell_start[cell + 1]; item++)
+                    {
+                        const uint32_t row = cell_items[item];
+                        const float dx = xs[row] - x;
+                        const float dy = ys[row] - y;
+                        insertNeighbour(dx * dx + dy * dy, row, k, found, rows, distances);
+                    }
+                }
+            }
+
+            const float reach = ring * cell_size;
+
+            if (found == k and distances[k - 1] <= reach * reach)
+                break;
+        }
+
+        for (uint32_t n = 0; n < found; n++)
+            distances[n] = std::sqrt(distances[n]);
+
+        return found;
+    }
+
+    // 128 note table blended in cents from the k nearest scales, weighted by inverse
+    // distance. Each scale is mapped like a generated corner: degree 0 on middle C.
+    bool blendTable(const float x, const float y, const uint32_t k, double* frequencies) const
+    {
+        uint32_t rows[kMaxNeighbours];
+        float distances[kMaxNeighbours];
+        const uint32_t found = nearest(x, y, k, rows, distances);
+
+        if (found == 0)
+            return false;
+
+        double weights[kMaxNeighbours];
+        double total = 0.0;
+
+        for (uint32_t n = 0; n < found; n++)
+        {
+            weights[n] = 1.0 / (distances[n] + 1.0e-4);
+            total += weights[n];
+        }
+
+        for (int32_t i = 0; i < 128; i++)
+        {
+            double cents = 0.0;
+
+            for (uint32_t n = 0; n < found; n++)
+                cents += weights[n] * centsForNote(rows[n], i);
+
+            frequencies[i] = ScaleGenerator::kRootFrequency * std::exp2(cents / (total * 1200.0));
+        }
+
+        return true;
+    }
+
+private:
+    static int32_t cellOf(const float position)
+    {
+        return limit(static_cast<int32_t>((position + 1.0f) * 0.5f * kGridCells), 0, kGridCells - 1);
+    }
+
+    // Keep the k smallest distances, sorted, in rows / distances
+    static void insertNeighbour(const float distance, const uint32_t row, const uint32_t k, uint32_t& found, uint32_t* rows, float* distances)
+    {
+        if (found == k and distance >= distances[k - 1])
+            return;
+
+        uint32_t slot = found < k ? found++ : k - 1;
+
+        while (slot > 0 and distances[slot - 1] > distance)
+        {
+            distances[slot] = distances[slot - 1];
+            rows[slot] = rows[slot - 1];
+            slot--;
+        }
+
+        distances[slot] = distance;
+        rows[slot] = row;
+    }
+
+    double centsForNote(const uint32_t row, const int32_t note) const
+    {
+        const int32_t count = note_counts[row];
+        const int32_t degree = note - ScaleGenerator::kRootNote;
+
+        if (count == 0)
+            return degree * 100.0;
+
+        const int32_t period = (degree >= 0 ? degree : degree - count + 1) / count;
+        const int32_t step = degree - period * count;
+        return period * static_cast<double>(periods[row]) + (step > 0 ? tones[first_tone[row] + step - 1] : 0.0);
+    }
+
+    // Points sorted into grid cells; cell c holds cell_items[cell_start[c] .. cell_start[c + 1])
+    void buildGrid()
+    {
+        const uint32_t count = getCount();
+        std::vector<int32_t> cells(count);
+        cell_start.assign(kGridCells * kGridCells + 1, 0);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            cells[i] = cellOf(ys[i]) * kGridCells + cellOf(xs[i]);
+            cell_start[cells[i] + 1]++;
+        }
+
+        for (int32_t c = 0; c < kGridCells * kGridCells; c++)
+            cell_start[c + 1] += cell_start[c];
+
+        std::vector<uint32_t> fill(cell_start.begin(), cell_start.end() - 1);
+        cell_items.resize(count);
+
+        for (uint32_t i = 0; i < count; i++)
+            cell_items[fill[cells[i]]++] = i;
+    }
+
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> periods;
+    std::vector<int32_t> note_counts;
+    std::vector<uint32_t> first_tone;
+    std::vector<float> tones;
+    std::vector<std::string> paths;
+    std::vector<uint32_t> cell_start;
+    std::vector<uint32_t> cell_items;
+
+    // Unique per load across all atlases in the process, so a blend can tell which
+    // contents it came from even when a new atlas reuses a freed one's address
+    uint64_t generation = 0;
+
+    static uint64_t nextGeneration()
+    {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+};
+
+// Builds the atlas file on its own thread, reusing the existing file when it was
+// built from the same library
+class ScaleAtlasBuilder
+{
+public:
+    ScaleAtlasBuilder()
+        : busy(false),
+          finished(false)
+    {
+    }
+
+    ~ScaleAtlasBuilder()
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // Takes the records, which may be large; ignored while a build is running
+    void start(std::vector<ScaleLibrary::Record>&& library)
+    {
+        if (busy.load())
+            return;
+
+        if (thread.joinable())
+            thread.join();
+
+        busy.store(true);
+        finished.store(false);
+        records = std::move(library);
+
+        thread = std::thread([this]()
+        {
+            const uint64_t library_signature = ScaleAtlasFormat::signature(records);
+            const std::string atlas_path = ScaleAtlasFormat::atlasPath(library_signature);
+            uint64_t existing = 0;
+            bool ok = true;
+
+            if (!ScaleAtlasFormat::readSignature(atlas_path, existing) or existing != library_signature)
+            {
+                std::vector<float> xs;
+                std::vector<float> ys;
+                ScaleAtlasFormat::embed(records, xs, ys);
+                ok = ScaleAtlasFormat::write(atlas_path, library_signature, records, xs, ys);
+            }
+
+            path = ok ? atlas_path : std::string();
+            records.clear();
+            finished.store(true);
+            busy.store(false);
+        });
+    }
+
+    bool isBusy() const { return busy.load(); }
+
+    // True once after each build finishes, with the atlas file, or an empty path if it
+    // could not be written
+    bool takeFinished(std::string& atlas_path)
+    {
+        if (!finished.exchange(false))
+            return false;
+
+        thread.join();
+        atlas_path = path;
+        return true;
+    }
+
+private:
+    std::atomic<bool> busy;
+    std::atomic<bool> finished;
+    std::vector<ScaleLibrary::Record> records;
+    std::string path;
+    std::thread thread;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define ScaleSpace_CONTROLS_HPP
 
 #include <array>
+#include <cstdint>
 
 template <class T>
 T limit (const T x, const T min, const T max)
@@ -9,10 +10,136 @@ T limit (const T x, const T min, const T max)
     return (x < min ? min : (x > max ? max : x));
 }
 
+// Set bit n of the 128 bit mask for every note whose value differs from the previous table
+template <class T>
+void changedNoteMask (const T* current, const T* previous, uint64_t mask[2])
+{
+    mask[0] = 0;
+    mask[1] = 0;
+    
+    for (uint32_t i = 0; i < 128; i++)
+    {
+        mask[i >> 6] |= static_cast<uint64_t>(current[i] != previous[i]) << (i & 63);
+    }
+}
+
 enum Parameters {
     kParameterX      = 0,
     kParameterY      = 1,
-    kParameterCount  = 2
+    kParameterReplacedNotes = 2,
+    kParameterClampedNotes  = 3,
+    kParameterJustIntonation = 4,
+    kParameterTrackingMode  = 5,
+    kParameterTrackedX      = 6,
+    kParameterTrackedY      = 7,
+    kParameterDetectedPitch = 8,
+    kParameterSysexOutput   = 9,
+    kParameterSysexDevice   = 10,
+    kParameterGridStrength  = 11,
+    kParameterZoneMode      = 12,
+    kParameterZone2Start    = 13,
+    kParameterZone2X        = 14,
+    kParameterZone2Y        = 15,
+    kParameterZone3Start    = 16,
+    kParameterZone3X        = 17,
+    kParameterZone3Y        = 18,
+    kParameterZone4Start    = 19,
+    kParameterZone4X        = 20,
+    kParameterZone4Y        = 21,
+    kParameterGradientLow   = 22,
+    kParameterGradientHigh  = 23,
+    kParameterCornerGain1   = 24,
+    kParameterCornerGain2   = 25,
+    kParameterCornerGain3   = 26,
+    kParameterCornerGain4   = 27,
+    kParameterWarpX         = 28,
+    kParameterWarpY         = 29,
+    kParameterWarpPower     = 30,
+    kParameterAlignReference = 31,
+    kParameterAlignNote     = 32,
+    kParameterAlignFrequency = 33,
+    kParameterKeyswitchEnable = 34,
+    kParameterKeyswitchBase = 35,
+    kParameterCrossfadeTime = 36,
+    kParameterActiveSlot    = 37,
+    kParameterHoldNotes     = 38,
+    kParameterDeadband      = 39,
+    kParameterSuppressedUpdates = 40,
+    kParameterUpdateRate    = 41,
+    kParameterPassive       = 42,
+    kParameterGenerator1    = 43,
+    kParameterGeneratorSize1 = 44,
+    kParameterGeneratorInterval1 = 45,
+    kParameterGeneratorPeriod1 = 46,
+    kParameterGenerator2    = 47,
+    kParameterGeneratorSize2 = 48,
+    kParameterGeneratorInterval2 = 49,
+    kParameterGeneratorPeriod2 = 50,
+    kParameterGenerator3    = 51,
+    kParameterGeneratorSize3 = 52,
+    kParameterGeneratorInterval3 = 53,
+    kParameterGeneratorPeriod3 = 54,
+    kParameterGenerator4    = 55,
+    kParameterGeneratorSize4 = 56,
+    kParameterGeneratorInterval4 = 57,
+    kParameterGeneratorPeriod4 = 58,
+    kParameterTranspose1    = 59,
+    kParameterTranspose2    = 60,
+    kParameterTranspose3    = 61,
+    kParameterTranspose4    = 62,
+    kParameterOctaveStretch = 63,
+    kParameterReferenceTrim = 64,
+    kParameterPreviewMode   = 65,
+    kParameterPreviewLevel  = 66,
+    kParameterPreviewChordRoot = 67,
+    kParameterLogEnable     = 68,
+    kParameterAtlasEnable   = 69,
+    kParameterAtlasNeighbours = 70,
+    kParameterLogDropped    = 71,
+    kParameterEditorLink    = 72,
+    kParameterCount  = 73
+};
+
+enum WarpCurves {
+    kWarpLinear    = 0,
+    kWarpEaseIn    = 1,
+    kWarpEaseOut   = 2,
+    kWarpEaseInOut = 3,
+    kWarpPower     = 4,
+    kWarpCurveCount = 5
+};
+
+enum ZoneModes {
+    kZoneModeOff      = 0,
+    kZoneModeZones    = 1,
+    kZoneModeGradient = 2,
+    kZoneModeCount    = 3
+};
+
+enum GeneratorTypes {
+    kGeneratorFile        = 0,
+    kGeneratorEDO         = 1,
+    kGeneratorHarmonic    = 2,
+    kGeneratorSubharmonic = 3,
+    kGeneratorMOS         = 4,
+    kGeneratorTypeCount   = 5
+};
+
+// Each corner's generator parameters are consecutive, corners kGeneratorStride apart
+static const int32_t kGeneratorStride = 4;
+
+enum PreviewModes {
+    kPreviewOff   = 0,
+    kPreviewMidi  = 1,
+    kPreviewChord = 2,
+    kPreviewModeCount = 3
+};
+
+enum TrackingModes {
+    kTrackingOff        = 0,
+    kTrackingPitchClass = 1,
+    kTrackingCorner     = 2,
+    kTrackingModeCount  = 3
 };
 
 enum States {
@@ -25,19 +152,183 @@ enum States {
     kStateFileKBM3 = 6,
     kStateFileKBM4 = 7,
     kStateFileSavePath = 8,
-    kStateCount    = 9
+    kStateFileSCLGrid = 9,
+    kStateFileKBMGrid = 10,
+    kStateFileSCLSlot1 = 11,
+    kStateFileSCLSlot2 = 12,
+    kStateFileSCLSlot3 = 13,
+    kStateFileSCLSlot4 = 14,
+    kStateFileKBMSlot1 = 15,
+    kStateFileKBMSlot2 = 16,
+    kStateFileKBMSlot3 = 17,
+    kStateFileKBMSlot4 = 18,
+    kStateNoteOverrides = 19,
+    kStateLogFile  = 20,
+    kStateLibraryFolders = 21,
+    kStateLibraryPack = 22,
+    kStateAtlasFile = 23,
+    kStateCount    = 24
 };
 
 static const std::array<std::pair<float, float>, kParameterCount> controlLimits =
 {{
     {-1.0f, 1.0f},   // kParameterX
-	{-1.0f, 1.0f}   // kParameterY
+	{-1.0f, 1.0f},   // kParameterY
+	{0.0f, 128.0f},  // kParameterReplacedNotes
+	{0.0f, 128.0f},  // kParameterClampedNotes
+	{0.0f, 1.0f},    // kParameterJustIntonation
+	{0.0f, 2.0f},    // kParameterTrackingMode
+	{-1.0f, 1.0f},   // kParameterTrackedX
+	{-1.0f, 1.0f},   // kParameterTrackedY
+	{0.0f, 2000.0f}, // kParameterDetectedPitch
+	{0.0f, 1.0f},    // kParameterSysexOutput
+	{0.0f, 127.0f},  // kParameterSysexDevice
+	{0.0f, 1.0f},    // kParameterGridStrength
+	{0.0f, 2.0f},    // kParameterZoneMode
+	{0.0f, 128.0f},  // kParameterZone2Start
+	{-1.0f, 1.0f},   // kParameterZone2X
+	{-1.0f, 1.0f},   // kParameterZone2Y
+	{0.0f, 128.0f},  // kParameterZone3Start
+	{-1.0f, 1.0f},   // kParameterZone3X
+	{-1.0f, 1.0f},   // kParameterZone3Y
+	{0.0f, 128.0f},  // kParameterZone4Start
+	{-1.0f, 1.0f},   // kParameterZone4X
+	{-1.0f, 1.0f},   // kParameterZone4Y
+	{0.0f, 127.0f},  // kParameterGradientLow
+	{0.0f, 127.0f},  // kParameterGradientHigh
+	{0.0f, 2.0f},    // kParameterCornerGain1
+	{0.0f, 2.0f},    // kParameterCornerGain2
+	{0.0f, 2.0f},    // kParameterCornerGain3
+	{0.0f, 2.0f},    // kParameterCornerGain4
+	{0.0f, 4.0f},    // kParameterWarpX
+	{0.0f, 4.0f},    // kParameterWarpY
+	{0.25f, 4.0f},   // kParameterWarpPower
+	{0.0f, 1.0f},    // kParameterAlignReference
+	{0.0f, 127.0f},  // kParameterAlignNote
+	{20.0f, 2000.0f},// kParameterAlignFrequency
+	{0.0f, 1.0f},    // kParameterKeyswitchEnable
+	{0.0f, 123.0f},  // kParameterKeyswitchBase
+	{0.0f, 5000.0f}, // kParameterCrossfadeTime
+	{0.0f, 4.0f},    // kParameterActiveSlot
+	{0.0f, 1.0f},    // kParameterHoldNotes
+	{0.0f, 20.0f},   // kParameterDeadband
+	{0.0f, 1000000.0f},// kParameterSuppressedUpdates
+	{0.0f, 2000.0f}, // kParameterUpdateRate
+	{0.0f, 1.0f},    // kParameterPassive
+	{0.0f, 4.0f},    // kParameterGenerator1
+	{1.0f, 96.0f},   // kParameterGeneratorSize1
+	{0.0f, 1200.0f}, // kParameterGeneratorInterval1
+	{100.0f, 2400.0f},// kParameterGeneratorPeriod1
+	{0.0f, 4.0f},    // kParameterGenerator2
+	{1.0f, 96.0f},   // kParameterGeneratorSize2
+	{0.0f, 1200.0f}, // kParameterGeneratorInterval2
+	{100.0f, 2400.0f},// kParameterGeneratorPeriod2
+	{0.0f, 4.0f},    // kParameterGenerator3
+	{1.0f, 96.0f},   // kParameterGeneratorSize3
+	{0.0f, 1200.0f}, // kParameterGeneratorInterval3
+	{100.0f, 2400.0f},// kParameterGeneratorPeriod3
+	{0.0f, 4.0f},    // kParameterGenerator4
+	{1.0f, 96.0f},   // kParameterGeneratorSize4
+	{0.0f, 1200.0f}, // kParameterGeneratorInterval4
+	{100.0f, 2400.0f},// kParameterGeneratorPeriod4
+	{-1200.0f, 1200.0f},// kParameterTranspose1
+	{-1200.0f, 1200.0f},// kParameterTranspose2
+	{-1200.0f, 1200.0f},// kParameterTranspose3
+	{-1200.0f, 1200.0f},// kParameterTranspose4
+	{-50.0f, 50.0f}, // kParameterOctaveStretch
+	{-100.0f, 100.0f},// kParameterReferenceTrim
+	{0.0f, 2.0f},    // kParameterPreviewMode
+	{0.0f, 1.0f},    // kParameterPreviewLevel
+	{0.0f, 115.0f},  // kParameterPreviewChordRoot
+	{0.0f, 1.0f},    // kParameterLogEnable
+	{0.0f, 1.0f},    // kParameterAtlasEnable
+	{1.0f, 8.0f},    // kParameterAtlasNeighbours
+	{0.0f, 1000000.0f}, // kParameterLogDropped
+	{0.0f, 16777215.0f} // kParameterEditorLink
 }};
 
+// Number of stored scale slots reachable by keyswitch (slot 0 is the live scale space)
+static const int32_t kSlotCount = 4;
+
 static const float ParameterDefaults[kParameterCount] = {
 	0.0f, //kParameterX
-	0.0f, //kParameterX,
+	0.0f, //kParameterY
+	0.0f, //kParameterReplacedNotes
+	0.0f, //kParameterClampedNotes
+	0.0f, //kParameterJustIntonation
+	0.0f, //kParameterTrackingMode
+	0.0f, //kParameterTrackedX
+	0.0f, //kParameterTrackedY
+	0.0f, //kParameterDetectedPitch
+	0.0f, //kParameterSysexOutput
+	127.0f, //kParameterSysexDevice
+	0.0f, //kParameterGridStrength
+	0.0f, //kParameterZoneMode
+	60.0f, //kParameterZone2Start
+	0.0f, //kParameterZone2X
+	0.0f, //kParameterZone2Y
+	128.0f, //kParameterZone3Start
+	0.0f, //kParameterZone3X
+	0.0f, //kParameterZone3Y
+	128.0f, //kParameterZone4Start
+	0.0f, //kParameterZone4X
+	0.0f, //kParameterZone4Y
+	36.0f, //kParameterGradientLow
+	96.0f, //kParameterGradientHigh
+	1.0f, //kParameterCornerGain1
+	1.0f, //kParameterCornerGain2
+	1.0f, //kParameterCornerGain3
+	1.0f, //kParameterCornerGain4
+	0.0f, //kParameterWarpX
+	0.0f, //kParameterWarpY
+	2.0f, //kParameterWarpPower
+	0.0f, //kParameterAlignReference
+	60.0f, //kParameterAlignNote
+	261.6256f, //kParameterAlignFrequency
+	0.0f, //kParameterKeyswitchEnable
+	24.0f, //kParameterKeyswitchBase
+	250.0f, //kParameterCrossfadeTime
+	0.0f, //kParameterActiveSlot
+	0.0f, //kParameterHoldNotes
+	0.0f, //kParameterDeadband
+	0.0f, //kParameterSuppressedUpdates
+	0.0f, //kParameterUpdateRate
+	0.0f, //kParameterPassive
+	0.0f, //kParameterGenerator1
+	12.0f, //kParameterGeneratorSize1
+	701.955f, //kParameterGeneratorInterval1
+	1200.0f, //kParameterGeneratorPeriod1
+	0.0f, //kParameterGenerator2
+	12.0f, //kParameterGeneratorSize2
+	701.955f, //kParameterGeneratorInterval2
+	1200.0f, //kParameterGeneratorPeriod2
+	0.0f, //kParameterGenerator3
+	12.0f, //kParameterGeneratorSize3
+	701.955f, //kParameterGeneratorInterval3
+	1200.0f, //kParameterGeneratorPeriod3
+	0.0f, //kParameterGenerator4
+	12.0f, //kParameterGeneratorSize4
+	701.955f, //kParameterGeneratorInterval4
+	1200.0f, //kParameterGeneratorPeriod4
+	0.0f, //kParameterTranspose1
+	0.0f, //kParameterTranspose2
+	0.0f, //kParameterTranspose3
+	0.0f, //kParameterTranspose4
+	0.0f, //kParameterOctaveStretch
+	0.0f, //kParameterReferenceTrim
+	0.0f, //kParameterPreviewMode
+	0.5f, //kParameterPreviewLevel
+	60.0f, //kParameterPreviewChordRoot
+	0.0f, //kParameterLogEnable
+	0.0f, //kParameterAtlasEnable
+	4.0f, //kParameterAtlasNeighbours
+	0.0f, //kParameterLogDropped
+	0.0f, //kParameterEditorLink
 };
 
+// Published note frequencies are kept inside this range (Hz)
+static const double kMinNoteFrequency = 1.0;
+static const double kMaxNoteFrequency = 24000.0;
+
 
 #endif
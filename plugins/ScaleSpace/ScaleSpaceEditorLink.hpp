@@ -0,0 +1,75 @@
+#ifndef ScaleSpace_EDITOR_LINK_HPP
+#define ScaleSpace_EDITOR_LINK_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include "ScaleSpaceParseResults.hpp"
+#include "ScaleSpaceSearch.hpp"
+
+// What the DSP shares with its editor when both run in the same process
+struct EditorLink : public ScaleParseResults, public TuningSnapshot
+{
+};
+
+// Process-wide table of editor links, so an editor can find its own DSP without DPF
+// direct access (which LV2 hosts only offer through instance-access). Each DSP files its
+// link under a random id and reports the id as an output parameter, which is never saved
+// with the project and so never follows a preset or a duplicated track. When the editor
+// runs in another process the id is simply never found, and the editor falls back to
+// doing the work itself.
+class EditorLinks
+{
+public:
+    // ids stay exact as float parameter values
+    static constexpr uint32_t kMaxId = (1u << 24) - 1;
+
+    static EditorLinks& instance()
+    {
+        static EditorLinks links;
+        return links;
+    }
+
+    // DSP side, when the plugin is created; returns the id to report
+    uint32_t publish(const std::shared_ptr<EditorLink>& link)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::uniform_int_distribution<uint32_t> distribution(1, kMaxId);
+        uint32_t id;
+
+        do
+        {
+            id = distribution(random);
+        } while (links.count(id) > 0);
+
+        links[id] = link;
+        return id;
+    }
+
+    // DSP side, when the plugin goes away
+    void withdraw(const uint32_t id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        links.erase(id);
+    }
+
+    // Editor side; null until the id has arrived, or when the DSP is in another process
+    std::shared_ptr<EditorLink> find(const uint32_t id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = links.find(id);
+        return it != links.end() ? it->second.lock() : nullptr;
+    }
+
+private:
+    EditorLinks() : random(std::random_device()()) {}
+
+    std::mutex mutex;
+    std::mt19937 random;
+    std::map<uint32_t, std::weak_ptr<EditorLink>> links;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef ScaleSpace_GENERATORS_HPP
+#define ScaleSpace_GENERATORS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "ScaleSpaceControls.hpp"
+
+// Built-in corner scales, computed straight into a 128 note frequency table.
+// Every parameter is continuous, so generators can be swept from automation;
+// a rebuild is one small step table and one flat pass over the notes.
+namespace ScaleGenerator
+{
+    // Generated scales are anchored like the default tuning: middle C at 261.6256 Hz
+    static constexpr int32_t kRootNote = 60;
+    static constexpr double kRootFrequency = 261.6256;
+    static constexpr int32_t kMaxSteps = 128;
+
+    // Fill frequencies from a step table of count cents values (steps[0] == 0) repeating every period
+    static inline void fillFromSteps(const double* steps, const int32_t count, const double period_cents, double* frequencies)
+    {
+        for (int32_t i = 0; i < 128; i++)
+        {
+            const int32_t degree = i - kRootNote;
+            const int32_t period = (degree >= 0 ? degree : degree - count + 1) / count;
+            const double cents = period * period_cents + steps[degree - period * count];
+            frequencies[i] = kRootFrequency * std::exp2(cents / 1200.0);
+        }
+    }
+
+    // N equal divisions of the period; N need not be whole
+    static inline void equalDivisions(const double divisions, const double period_cents, double* frequencies)
+    {
+        const double step_cents = period_cents / std::max(divisions, 1.0e-3);
+
+        for (int32_t i = 0; i < 128; i++)
+        {
+            frequencies[i] = kRootFrequency * std::exp2((i - kRootNote) * step_cents / 1200.0);
+        }
+    }
+
+    // Harmonics n, n+1, ... below 2n, or the mirrored subharmonics 2n/2n, 2n/(2n-1), ... above n,
+    // stretched to the period. Fractional n slides smoothly between modes.
+    static inline void harmonicSeries(const double size, const bool subharmonic, const double period_cents, double* frequencies)
+    {
+        const double n = std::max(size, 1.0);
+        const int32_t count = std::min(static_cast<int32_t>(std::ceil(n)), kMaxSteps);
+        const double stretch = period_cents / 1200.0;
+        double steps[kMaxSteps];
+
+        for (int32_t k = 0; k < count; k++)
+        {
+            const double ratio = subharmonic ? (2.0 * n) / (2.0 * n - k) : (n + k) / n;
+            steps[k] = 1200.0 * std::log2(ratio) * stretch;
+        }
+
+        fillFromSteps(steps, count, period_cents, frequencies);
+    }
+
+    // Moment of symmetry / rank-2 scale: count stacked generators, reduced into the period and sorted
+    static inline void rankTwo(const double size, const double generator_cents, const double period_cents, double* frequencies)
+    {
+        const int32_t count = limit(static_cast<int32_t>(std::lround(size)), 1, kMaxSteps);
+        const double period = std::max(period_cents, 1.0);
+        double steps[kMaxSteps];
+
+        for (int32_t j = 0; j < count; j++)
+        {
+            const double stacked = j * generator_cents;
+            steps[j] = stacked - std::floor(stacked / period) * period;
+        }
+
+        std::sort(steps, steps + count);
+        fillFromSteps(steps, count, period, frequencies);
+    }
+}
+
+#endif
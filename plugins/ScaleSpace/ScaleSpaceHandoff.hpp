@@ -0,0 +1,62 @@
+#ifndef ScaleSpace_HANDOFF_HPP
+#define ScaleSpace_HANDOFF_HPP
+
+#include <atomic>
+
+// Hands objects built off the audio thread to run() without locks, and without
+// run() ever allocating or freeing. publish() posts a new object; run() takes it
+// with acquire(), which retires the object it was using. The retired object is
+// only deleted by a later publish(), after run() has stopped using it, so a
+// writer never touches an object the audio thread may still be reading.
+template <class T>
+class RealtimeHandoff
+{
+public:
+    RealtimeHandoff()
+        : current(new T()),
+          pending(nullptr),
+          retired(nullptr)
+    {
+    }
+
+    ~RealtimeHandoff()
+    {
+        delete current;
+        delete pending.load();
+        delete retired.load();
+    }
+
+    RealtimeHandoff(const RealtimeHandoff&) = delete;
+    RealtimeHandoff& operator=(const RealtimeHandoff&) = delete;
+
+    // Writer side: takes ownership of next. An object posted earlier that run()
+    // never took is deleted here, as is the one run() has finished with.
+    void publish(T* next)
+    {
+        delete retired.exchange(nullptr, std::memory_order_acq_rel);
+        delete pending.exchange(next, std::memory_order_acq_rel);
+    }
+
+    // Audio thread; realtime safe. The newest published object, valid until the
+    // next acquire() on this handoff.
+    T* acquire()
+    {
+        if (retired.load(std::memory_order_acquire) == nullptr)
+        {
+            if (T* const next = pending.exchange(nullptr, std::memory_order_acq_rel))
+            {
+                retired.store(current, std::memory_order_release);
+                current = next;
+            }
+        }
+
+        return current;
+    }
+
+private:
+    T* current;                  // only touched by the audio thread after construction
+    std::atomic<T*> pending;
+    std::atomic<T*> retired;
+};
+
+#endif
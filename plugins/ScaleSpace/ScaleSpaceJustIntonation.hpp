@@ -0,0 +1,112 @@
+#ifndef ScaleSpace_JUST_INTONATION_HPP
+#define ScaleSpace_JUST_INTONATION_HPP
+
+#include <cmath>
+#include <cstdint>
+
+// Lookup tables for the adaptive just intonation mode.
+// Everything is built once in the constructor so that chord analysis on the
+// audio thread is a couple of table reads per MIDI event.
+class JustIntonationLattice
+{
+public:
+    JustIntonationLattice()
+    {
+        buildIntervalTable();
+        buildRootTable();
+    }
+
+    // Just ratio for an interval in semitones (any sign, octaves included)
+    double ratioForInterval(const int semitones) const
+    {
+        const int interval_class = ((semitones % 12) + 12) % 12;
+        const int octaves = (semitones - interval_class) / 12;
+        return interval_ratios[interval_class] * std::ldexp(1.0, octaves);
+    }
+
+    // Root pitch class (0-11) of a 12 bit pitch class set, or -1 if the set is empty
+    int rootForPitchClasses(const uint16_t pitch_class_mask) const
+    {
+        return root_table[pitch_class_mask & 0xFFF];
+    }
+
+private:
+    // Walk the 5-limit lattice 3^a * 5^b and keep, for each equal tempered interval
+    // class, the simplest ratio (lowest Tenney height) lying within 50 cents of it.
+    void buildIntervalTable()
+    {
+        for (int i = 0; i < 12; i++)
+        {
+            interval_ratios[i] = std::exp2(i / 12.0);
+            interval_heights[i] = 1.0e9;
+        }
+
+        for (int a = -4; a <= 4; a++)
+        {
+            for (int b = -2; b <= 2; b++)
+            {
+                double numerator = 1.0;
+                double denominator = 1.0;
+                (a >= 0 ? numerator : denominator) *= std::pow(3.0, std::abs(a));
+                (b >= 0 ? numerator : denominator) *= std::pow(5.0, std::abs(b));
+
+                // octave reduce into [1, 2)
+                while (numerator / denominator >= 2.0)
+                    denominator *= 2.0;
+                while (numerator / denominator < 1.0)
+                    numerator *= 2.0;
+
+                const double cents = 1200.0 * std::log2(numerator / denominator);
+                const int interval_class = static_cast<int>(std::lround(cents / 100.0)) % 12;
+                const double height = std::log2(numerator * denominator);
+
+                if (std::fabs(cents - 100.0 * std::lround(cents / 100.0)) < 50.0 and height < interval_heights[interval_class])
+                {
+                    interval_ratios[interval_class] = numerator / denominator;
+                    interval_heights[interval_class] = height;
+                }
+            }
+        }
+    }
+
+    // For every pitch class set pick the member that makes the other members
+    // the simplest ratios above it, i.e. the lowest summed Tenney height.
+    void buildRootTable()
+    {
+        root_table[0] = -1;
+
+        for (int mask = 1; mask < 4096; mask++)
+        {
+            int best_root = -1;
+            double best_score = 0.0;
+
+            for (int root = 0; root < 12; root++)
+            {
+                if (!(mask & (1 << root)))
+                    continue;
+
+                double score = 0.0;
+
+                for (int pc = 0; pc < 12; pc++)
+                {
+                    if (mask & (1 << pc))
+                        score += interval_heights[(pc - root + 12) % 12];
+                }
+
+                if (best_root < 0 or score < best_score)
+                {
+                    best_root = root;
+                    best_score = score;
+                }
+            }
+
+            root_table[mask] = static_cast<int8_t>(best_root);
+        }
+    }
+
+    double interval_ratios[12];
+    double interval_heights[12];
+    int8_t root_table[4096];
+};
+
+#endif
@@ -0,0 +1,733 @@
+#ifndef ScaleSpace_LIBRARY_HPP
+#define ScaleSpace_LIBRARY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "Tunings.h"
+
+// Scale library: an index of every .scl file under a set of folders, so scales can be
+// picked (and later searched) by name, size and shape without touching the files.
+//
+// Each scale gets a fingerprint: a soft histogram of its degrees over one period, with
+// the period normalised to the unit interval and the vector scaled to unit length. Two
+// scales with similar fingerprints sound alike whatever their note count or period.
+//
+// Index file layout (little endian): "SSLI", a version byte, u32 record count, then per
+// record: u16 length + path, u16 length + description, i64 mtime, i64 size,
+// u16 note count, f32 period in cents, the fingerprint as kFingerprintSize bytes
+// (each bin scaled so the largest is 255), and note count f32 tones in cents.
+namespace ScaleLibrary
+{
+    static constexpr char kIndexMagic[4] = { 'S', 'S', 'L', 'I' };
+    static constexpr uint8_t kIndexVersion = 2;
+    static constexpr int32_t kFingerprintSize = 64;
+
+    struct Record
+    {
+        std::string path;
+        std::string name;         // file name without its folders
+        std::string description;
+        int64_t mtime;
+        int64_t size;
+        int32_t note_count;
+        float period_cents;
+        float fingerprint[kFingerprintSize];
+        std::vector<float> tones;  // cents of degrees 1 to note_count; the last is the period
+    };
+
+    // A library scale wherever it is stored (an index record or a pack), for display and search
+    struct Entry
+    {
+        const char* path;
+        const char* name;
+        const char* description;
+        int32_t note_count;
+        float period_cents;
+        const float* fingerprint;
+        const float* tones;
+    };
+
+    static inline Entry entryFor(const Record& record)
+    {
+        return Entry { record.path.c_str(), record.name.c_str(), record.description.c_str(),
+                       record.note_count, record.period_cents, record.fingerprint, record.tones.data() };
+    }
+
+    // A full record from an entry, e.g. to combine pack scales with index records
+    static inline Record recordFor(const Entry& entry)
+    {
+        Record record;
+        record.path = entry.path;
+        record.name = entry.name;
+        record.description = entry.description;
+        record.mtime = 0;
+        record.size = 0;
+        record.note_count = entry.note_count;
+        record.period_cents = entry.period_cents;
+        std::memcpy(record.fingerprint, entry.fingerprint, sizeof(record.fingerprint));
+        record.tones.assign(entry.tones, entry.tones + entry.note_count);
+        return record;
+    }
+
+    static inline std::string baseName(const std::string& path)
+    {
+        return path.substr(path.find_last_of("/\\") + 1);
+    }
+
+    // Soft histogram of pitches (cents, any range) folded into one period
+    static inline void fingerprintPitches(const double* cents, const int32_t count, const double period_cents, float* fingerprint)
+    {
+        const double period = period_cents > 0.0 ? period_cents : 1200.0;
+
+        for (int32_t b = 0; b < kFingerprintSize; b++)
+            fingerprint[b] = 0.0f;
+
+        for (int32_t i = 0; i < count; i++)
+        {
+            if (!std::isfinite(cents[i]))
+                continue;
+
+            double position = cents[i] / period;
+            position = (position - std::floor(position)) * kFingerprintSize;
+
+            // Spread each pitch over its neighbouring bins, wrapping round the period
+            const int32_t centre = static_cast<int32_t>(position);
+
+            for (int32_t offset = -2; offset <= 2; offset++)
+            {
+                const int32_t bin = centre + offset;
+                const double distance = (bin + 0.5) - position;
+                const int32_t wrapped = ((bin % kFingerprintSize) + kFingerprintSize) % kFingerprintSize;
+                fingerprint[wrapped] += static_cast<float>(std::exp(-distance * distance));
+            }
+        }
+
+        float length = 0.0f;
+
+        for (int32_t b = 0; b < kFingerprintSize; b++)
+            length += fingerprint[b] * fingerprint[b];
+
+        length = length > 0.0f ? 1.0f / std::sqrt(length) : 0.0f;
+
+        for (int32_t b = 0; b < kFingerprintSize; b++)
+            fingerprint[b] *= length;
+    }
+
+    // Note count, period and fingerprint of a parsed scale
+    static inline void describeScale(const Tunings::Scale& scale, Record& record)
+    {
+        const int32_t count = static_cast<int32_t>(scale.tones.size());
+        const double period = count > 0 ? scale.tones.back().cents : 1200.0;
+        std::vector<double> cents(std::max(count, 1));
+
+        // degree 0 is implied; the last tone is the period, which folds onto it
+        cents[0] = 0.0;
+
+        for (int32_t i = 1; i < count; i++)
+            cents[i] = scale.tones[i - 1].cents;
+
+        record.tones.resize(count);
+
+        for (int32_t i = 0; i < count; i++)
+            record.tones[i] = static_cast<float>(scale.tones[i].cents);
+
+        record.description = scale.description;
+        record.note_count = count;
+        record.period_cents = static_cast<float>(period);
+        fingerprintPitches(cents.data(), std::max(count, 1), period, record.fingerprint);
+    }
+
+    static inline bool statFile(const char* path, int64_t& mtime, int64_t& size)
+    {
+        struct stat info;
+
+        if (stat(path, &info) != 0)
+            return false;
+
+        mtime = static_cast<int64_t>(info.st_mtime);
+        size = static_cast<int64_t>(info.st_size);
+        return true;
+    }
+
+    // Read and parse one file into record; false if it is not a usable scale
+    static inline bool indexFile(const std::string& path, Record& record)
+    {
+        std::ifstream stream(path, std::ios::in | std::ios::binary);
+
+        if (!stream.is_open())
+            return false;
+
+        std::stringstream buffer;
+        buffer << stream.rdbuf();
+
+        try
+        {
+            describeScale(Tunings::parseSCLData(buffer.str()), record);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+
+        record.path = path;
+        record.name = baseName(path);
+        return true;
+    }
+
+    // Every .scl file under the folders, sorted so indexes are stable
+    static inline std::vector<std::string> findScaleFiles(const std::vector<std::string>& folders)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::string> files;
+
+        for (const std::string& folder : folders)
+        {
+            // absolute, so records still find their files from any working directory
+            std::error_code error;
+            const fs::path root = fs::absolute(folder, error);
+            fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, error);
+
+            for (; !error and it != fs::recursive_directory_iterator(); it.increment(error))
+            {
+                std::string extension = it->path().extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+                if (extension == ".scl" and it->is_regular_file(error))
+                    files.push_back(it->path().string());
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+        return files;
+    }
+
+    // Folders are kept in plugin state one per line
+    static inline std::vector<std::string> splitFolders(const char* text)
+    {
+        std::vector<std::string> folders;
+        std::string line;
+        std::istringstream stream(text != nullptr ? text : "");
+
+        while (std::getline(stream, line))
+        {
+            if (!line.empty() and line.back() == '\r')
+                line.pop_back();
+
+            if (!line.empty())
+                folders.push_back(line);
+        }
+
+        return folders;
+    }
+
+    // The user's ScaleSpace settings folder, where indexes and atlases are kept
+    static inline std::string settingsFolder()
+    {
+#if defined(_WIN32)
+        const char* base = std::getenv("APPDATA");
+        return base != nullptr ? std::string(base) + "\\ScaleSpace" : std::string(".");
+#elif defined(__APPLE__)
+        const char* home = std::getenv("HOME");
+        return std::string(home != nullptr ? home : ".") + "/Library/Application Support/ScaleSpace";
+#else
+        const char* config = std::getenv("XDG_CONFIG_HOME");
+        const char* home = std::getenv("HOME");
+        std::string folder = config != nullptr ? std::string(config) : std::string(home != nullptr ? home : ".") + "/.config";
+        return folder + "/ScaleSpace";
+#endif
+    }
+
+    // Where the index of one set of folders is kept between sessions. Each set has its
+    // own file, so editors showing different folders never overwrite each other's index.
+    static inline std::string indexPathFor(const std::vector<std::string>& folders)
+    {
+        std::vector<std::string> sorted(folders);
+        std::sort(sorted.begin(), sorted.end());
+
+        // 64 bit FNV-1a over the folder names, each ended by a newline
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (const std::string& folder : sorted)
+        {
+            for (const char c : folder + "\n")
+            {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 1099511628211ULL;
+            }
+        }
+
+        char name[40];
+        std::snprintf(name, sizeof(name), "library-%016llx.ssindex", static_cast<unsigned long long>(hash));
+        return (std::filesystem::path(settingsFolder()) / name).string();
+    }
+
+    // A temporary file name beside path that no other writer (another editor, or the
+    // pack tool) will pick, so concurrent saves never write into the same file
+    static inline std::string temporaryPath(const std::string& path)
+    {
+        std::random_device device;
+        char suffix[24];
+        std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", static_cast<unsigned>(device()));
+        return path + suffix;
+    }
+
+    // Move a finished temporary file over path in one step, replacing any old file.
+    // A reader sees either the old file or the new one, never neither.
+    static inline bool replaceFile(const std::string& temporary, const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+
+        if (!error)
+            return true;
+
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    // Little endian field helpers for the library's binary files
+    static inline void writeU16(std::FILE* file, const uint16_t value)
+    {
+        const uint8_t bytes[2] = { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8) };
+        std::fwrite(bytes, 1, 2, file);
+    }
+
+    static inline void writeU32(std::FILE* file, const uint32_t value)
+    {
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+            std::fputc(static_cast<uint8_t>(value >> shift), file);
+    }
+
+    static inline void writeI64(std::FILE* file, const int64_t value)
+    {
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+            std::fputc(static_cast<uint8_t>(static_cast<uint64_t>(value) >> shift), file);
+    }
+
+    static inline void writeF32(std::FILE* file, const float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        writeU32(file, bits);
+    }
+
+    static inline void writeString(std::FILE* file, const std::string& text)
+    {
+        const uint16_t size = static_cast<uint16_t>(std::min<size_t>(text.size(), 65535));
+        writeU16(file, size);
+        std::fwrite(text.data(), 1, size, file);
+    }
+
+    static inline bool readBytes(std::FILE* file, uint64_t& value, const uint32_t count)
+    {
+        uint8_t bytes[8];
+
+        if (std::fread(bytes, 1, count, file) != count)
+            return false;
+
+        value = 0;
+
+        for (uint32_t i = 0; i < count; i++)
+            value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+
+        return true;
+    }
+
+    static inline bool readU16(std::FILE* file, uint16_t& value)
+    {
+        uint64_t bits = 0;
+        const bool ok = readBytes(file, bits, 2);
+        value = static_cast<uint16_t>(bits);
+        return ok;
+    }
+
+    static inline bool readU32(std::FILE* file, uint32_t& value)
+    {
+        uint64_t bits = 0;
+        const bool ok = readBytes(file, bits, 4);
+        value = static_cast<uint32_t>(bits);
+        return ok;
+    }
+
+    static inline bool readI64(std::FILE* file, int64_t& value)
+    {
+        uint64_t bits = 0;
+        const bool ok = readBytes(file, bits, 8);
+        value = static_cast<int64_t>(bits);
+        return ok;
+    }
+
+    static inline bool readF32(std::FILE* file, float& value)
+    {
+        uint32_t bits = 0;
+        const bool ok = readU32(file, bits);
+        std::memcpy(&value, &bits, 4);
+        return ok;
+    }
+
+    static inline bool readString(std::FILE* file, std::string& text)
+    {
+        uint16_t size = 0;
+
+        if (!readU16(file, size))
+            return false;
+
+        text.resize(size);
+        return std::fread(&text[0], 1, size, file) == size;
+    }
+
+    class Index
+    {
+    public:
+        std::vector<Record> records;
+
+        bool load(const std::string& path)
+        {
+            records.clear();
+            std::FILE* file = std::fopen(path.c_str(), "rb");
+
+            if (file == nullptr)
+                return false;
+
+            char magic[4];
+            uint32_t count = 0;
+            bool ok = std::fread(magic, 1, 4, file) == 4 and std::memcmp(magic, kIndexMagic, 4) == 0
+                      and std::fgetc(file) == kIndexVersion and readU32(file, count);
+
+            for (uint32_t i = 0; ok and i < count; i++)
+            {
+                Record record;
+                uint16_t note_count = 0;
+                uint8_t bins[kFingerprintSize];
+
+                ok = readString(file, record.path) and readString(file, record.description)
+                     and readI64(file, record.mtime) and readI64(file, record.size)
+                     and readU16(file, note_count) and readF32(file, record.period_cents)
+                     and std::fread(bins, 1, kFingerprintSize, file) == kFingerprintSize;
+
+                record.tones.resize(note_count);
+
+                for (uint16_t t = 0; ok and t < note_count; t++)
+                    ok = readF32(file, record.tones[t]);
+
+                if (!ok)
+                    break;
+
+                record.name = baseName(record.path);
+                record.note_count = note_count;
+                unpackFingerprint(bins, record.fingerprint);
+                records.push_back(std::move(record));
+            }
+
+            std::fclose(file);
+
+            if (!ok)
+                records.clear();
+
+            return ok;
+        }
+
+        bool save(const std::string& path) const
+        {
+            std::error_code error;
+            std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+            // Write beside the old index and swap, so a reader never sees half a file
+            const std::string temporary = temporaryPath(path);
+            std::FILE* file = std::fopen(temporary.c_str(), "wb");
+
+            if (file == nullptr)
+                return false;
+
+            std::fwrite(kIndexMagic, 1, 4, file);
+            std::fputc(kIndexVersion, file);
+            writeU32(file, static_cast<uint32_t>(records.size()));
+
+            for (const Record& record : records)
+            {
+                uint8_t bins[kFingerprintSize];
+                packFingerprint(record.fingerprint, bins);
+
+                writeString(file, record.path);
+                writeString(file, record.description);
+                writeI64(file, record.mtime);
+                writeI64(file, record.size);
+                const int32_t note_count = std::min(limitCount(record.note_count), static_cast<int32_t>(record.tones.size()));
+                writeU16(file, static_cast<uint16_t>(note_count));
+                writeF32(file, record.period_cents);
+                std::fwrite(bins, 1, kFingerprintSize, file);
+
+                for (int32_t t = 0; t < note_count; t++)
+                    writeF32(file, record.tones[t]);
+            }
+
+            const bool ok = std::ferror(file) == 0;
+            std::fclose(file);
+
+            if (!ok)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+
+            return replaceFile(temporary, path);
+        }
+
+    private:
+        static int32_t limitCount(const int32_t count)
+        {
+            return std::min(std::max(count, 0), 65535);
+        }
+
+        static void packFingerprint(const float* fingerprint, uint8_t* bins)
+        {
+            float largest = 0.0f;
+
+            for (int32_t b = 0; b < kFingerprintSize; b++)
+                largest = std::max(largest, fingerprint[b]);
+
+            const float scale = largest > 0.0f ? 255.0f / largest : 0.0f;
+
+            for (int32_t b = 0; b < kFingerprintSize; b++)
+                bins[b] = static_cast<uint8_t>(std::lround(fingerprint[b] * scale));
+        }
+
+        static void unpackFingerprint(const uint8_t* bins, float* fingerprint)
+        {
+            float length = 0.0f;
+
+            for (int32_t b = 0; b < kFingerprintSize; b++)
+            {
+                fingerprint[b] = bins[b];
+                length += fingerprint[b] * fingerprint[b];
+            }
+
+            length = length > 0.0f ? 1.0f / std::sqrt(length) : 0.0f;
+
+            for (int32_t b = 0; b < kFingerprintSize; b++)
+                fingerprint[b] *= length;
+        }
+    };
+
+    // Bring index up to date with the folders. Files whose mtime and size match their
+    // old record are kept as they are; new and changed files are parsed by a pool of
+    // threads. done counts files as they are handled, for progress display. Returns false,
+    // leaving index as it was, if cancel was set before the scan finished.
+    static inline bool scan(const std::vector<std::string>& folders, Index& index, std::atomic<uint32_t>& done, std::atomic<uint32_t>& total,
+                            const std::atomic<bool>* cancel = nullptr, uint32_t threads = 0)
+    {
+        const std::vector<std::string> files = findScaleFiles(folders);
+
+        std::map<std::string, const Record*> previous;
+
+        for (const Record& record : index.records)
+            previous[record.path] = &record;
+
+        std::vector<Record> records(files.size());
+        std::vector<uint8_t> usable(files.size(), 0);
+        std::vector<uint32_t> pending;
+
+        total.store(static_cast<uint32_t>(files.size()));
+        done.store(0);
+
+        for (uint32_t i = 0; i < files.size(); i++)
+        {
+            int64_t mtime = 0;
+            int64_t size = 0;
+
+            if (!statFile(files[i].c_str(), mtime, size))
+            {
+                done.fetch_add(1);
+                continue;
+            }
+
+            auto known = previous.find(files[i]);
+
+            if (known != previous.end() and known->second->mtime == mtime and known->second->size == size)
+            {
+                records[i] = *known->second;
+                usable[i] = 1;
+                done.fetch_add(1);
+                continue;
+            }
+
+            records[i].mtime = mtime;
+            records[i].size = size;
+            pending.push_back(i);
+        }
+
+        // Workers take the next pending file until none are left; each writes only its own slots
+        std::atomic<uint32_t> next(0);
+
+        auto worker = [&]()
+        {
+            for (uint32_t p = next.fetch_add(1); p < pending.size(); p = next.fetch_add(1))
+            {
+                if (cancel != nullptr and cancel->load())
+                    return;
+
+                const uint32_t i = pending[p];
+                usable[i] = indexFile(files[i], records[i]) ? 1 : 0;
+                done.fetch_add(1);
+            }
+        };
+
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        threads = std::min<uint32_t>(threads, std::max<size_t>(pending.size(), 1));
+
+        std::vector<std::thread> pool;
+
+        for (uint32_t t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+
+        worker();
+
+        for (std::thread& thread : pool)
+            thread.join();
+
+        if (cancel != nullptr and cancel->load())
+            return false;
+
+        index.records.clear();
+
+        for (uint32_t i = 0; i < files.size(); i++)
+        {
+            if (usable[i])
+                index.records.push_back(std::move(records[i]));
+        }
+
+        return true;
+    }
+}
+
+// Runs ScaleLibrary::scan on its own thread so the UI stays responsive, and keeps
+// the index file up to date when a scan finishes. A scan asked for while one is
+// running is queued, and runs straight after it; only the latest request is kept.
+class ScaleLibraryScanner
+{
+public:
+    ScaleLibraryScanner()
+        : busy(false),
+          finished(false),
+          cancel(false),
+          done(0),
+          total(0),
+          queued(false)
+    {
+    }
+
+    ~ScaleLibraryScanner()
+    {
+        cancel.store(true);
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // Start updating index in the background, or queue it while a scan is running
+    void start(const std::vector<std::string>& folders, const ScaleLibrary::Index& index, const std::string& index_path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+
+            if (busy.load())
+            {
+                queued_folders = folders;
+                queued_index = index;
+                queued_path = index_path;
+                queued = true;
+                return;
+            }
+        }
+
+        if (thread.joinable())
+            thread.join();
+
+        busy.store(true);
+        finished.store(false);
+        result = index;
+
+        thread = std::thread([this, folders, index_path]()
+        {
+            std::vector<std::string> scan_folders(folders);
+            std::string scan_path(index_path);
+
+            for (;;)
+            {
+                const bool scanned = ScaleLibrary::scan(scan_folders, result, done, total, &cancel);
+
+                if (scanned)
+                    result.save(scan_path);
+
+                std::lock_guard<std::mutex> lock(queue_mutex);
+
+                if (!queued or cancel.load())
+                {
+                    // only the last scan's result is handed over
+                    finished.store(scanned);
+                    busy.store(false);
+                    return;
+                }
+
+                scan_folders.swap(queued_folders);
+                scan_path.swap(queued_path);
+                result.records.swap(queued_index.records);
+                queued_index.records.clear();
+                queued = false;
+            }
+        });
+    }
+
+    bool isBusy() const { return busy.load(); }
+    uint32_t getDone() const { return done.load(); }
+    uint32_t getTotal() const { return total.load(); }
+
+    // Hand over the updated index once, after a scan finishes
+    bool takeResult(ScaleLibrary::Index& index)
+    {
+        if (!finished.exchange(false))
+            return false;
+
+        thread.join();
+        index.records.swap(result.records);
+        result.records.clear();
+        return true;
+    }
+
+private:
+    std::atomic<bool> busy;
+    std::atomic<bool> finished;
+    std::atomic<bool> cancel;
+    std::atomic<uint32_t> done;
+    std::atomic<uint32_t> total;
+    ScaleLibrary::Index result;
+    std::thread thread;
+
+    // The scan asked for while busy
+    std::mutex queue_mutex;
+    bool queued;
+    std::vector<std::string> queued_folders;
+    ScaleLibrary::Index queued_index;
+    std::string queued_path;
+};
+
+#endif
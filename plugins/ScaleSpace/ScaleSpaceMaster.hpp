@@ -0,0 +1,118 @@
+#ifndef ScaleSpace_MASTER_HPP
+#define ScaleSpace_MASTER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "libMTSMaster.h"
+
+// Hands out the MTS-ESP master slot. Instances that find it taken wait here, and one
+// process-wide thread checks twice a second while any are waiting, so the audio thread
+// never calls into libMTS to register. Checking and registering happen under one lock,
+// so two instances in this process never both see the slot free; the instance that has
+// waited longest gets it. The thread only exists while someone is waiting.
+class MasterTakeover
+{
+public:
+    static MasterTakeover& instance()
+    {
+        static MasterTakeover takeover;
+        return takeover;
+    }
+
+    ~MasterTakeover()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // Register as master now if the slot is free, or wait for it. granted is set
+    // once this instance is the master; run() only reads it.
+    void request(std::atomic<bool>* granted)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (waiting.empty() and MTS_CanRegisterMaster())
+        {
+            MTS_RegisterMaster();
+            granted->store(true, std::memory_order_release);
+            return;
+        }
+
+        granted->store(false, std::memory_order_release);
+        waiting.push_back(granted);
+
+        if (!running)
+        {
+            // a previous poll thread has finished, or is just returning
+            if (thread.joinable())
+                thread.join();
+
+            running = true;
+            thread = std::thread([this]() { poll(); });
+        }
+    }
+
+    // Stop waiting. Afterwards granted no longer changes, so the caller can check it
+    // to see whether it has to deregister.
+    void withdraw(std::atomic<bool>* granted)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto it = waiting.begin(); it != waiting.end(); ++it)
+        {
+            if (*it == granted)
+            {
+                waiting.erase(it);
+                break;
+            }
+        }
+    }
+
+private:
+    static constexpr int kPollMilliseconds = 500;
+
+    MasterTakeover()
+        : running(false),
+          stopping(false)
+    {
+    }
+
+    void poll()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!waiting.empty() and !stopping)
+        {
+            wake.wait_for(lock, std::chrono::milliseconds(kPollMilliseconds));
+
+            if (!waiting.empty() and !stopping and MTS_CanRegisterMaster())
+            {
+                MTS_RegisterMaster();
+                waiting.front()->store(true, std::memory_order_release);
+                waiting.pop_front();
+            }
+        }
+
+        running = false;
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::atomic<bool>*> waiting;
+    std::thread thread;
+    bool running;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef ScaleSpace_OVERRIDES_HPP
+#define ScaleSpace_OVERRIDES_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Per-note frequency overrides ("pins"): a frequency for each MIDI note and a
+// 128 bit mask of the notes that are pinned. Stored in plugin state as text,
+// e.g. "36=65.406000 60=261.626000", shared by the DSP and the UI. The text always
+// uses '.' for decimals, whatever the host's locale, so saved pins load anywhere.
+struct NoteOverrides
+{
+    double frequencies[128];
+    uint64_t mask[2];
+
+    NoteOverrides()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for (uint32_t i = 0; i < 128; i++)
+            frequencies[i] = 0.0;
+
+        mask[0] = 0;
+        mask[1] = 0;
+    }
+
+    bool isPinned(const uint32_t note) const
+    {
+        return (mask[(note & 127) >> 6] >> (note & 63)) & 1;
+    }
+
+    void pin(const uint32_t note, const double frequency)
+    {
+        frequencies[note & 127] = frequency;
+        mask[(note & 127) >> 6] |= 1ULL << (note & 63);
+    }
+
+    void unpin(const uint32_t note)
+    {
+        mask[(note & 127) >> 6] &= ~(1ULL << (note & 63));
+    }
+
+    // Read "note=frequency" pairs, ignoring anything malformed or out of range
+    void parse(const char* text)
+    {
+        clear();
+
+        if (text == nullptr)
+            return;
+
+        const char* p = text;
+
+        while (*p != '\0')
+        {
+            char* end = nullptr;
+            const long note = std::strtol(p, &end, 10);
+
+            if (end == p)
+            {
+                p++;
+                continue;
+            }
+
+            p = end;
+
+            if (*p != '=')
+                continue;
+
+            p++;
+            double frequency = 0.0;
+
+            if (!parseDecimal(p, frequency))
+                continue;
+
+            if (note >= 0 and note < 128 and std::isfinite(frequency) and frequency > 0.0)
+                pin(static_cast<uint32_t>(note), frequency);
+        }
+    }
+
+    std::string serialise() const
+    {
+        std::string text;
+        char entry[32];
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            if (!isPinned(i))
+                continue;
+
+            // six decimals, printed as two integers so the locale cannot change the separator
+            const long long micro = std::llround(frequencies[i] * 1.0e6);
+            std::snprintf(entry, sizeof(entry), "%s%u=%lld.%06lld", text.empty() ? "" : " ", i, micro / 1000000, micro % 1000000);
+            text += entry;
+        }
+
+        return text;
+    }
+
+private:
+    // Unsigned decimal with an optional '.' fraction, read without the C locale
+    static bool parseDecimal(const char*& p, double& value)
+    {
+        const char* const start = p;
+        value = 0.0;
+
+        while (*p >= '0' and *p <= '9')
+            value = value * 10.0 + (*p++ - '0');
+
+        if (*p == '.')
+        {
+            p++;
+            double scale = 0.1;
+
+            while (*p >= '0' and *p <= '9')
+            {
+                value += (*p++ - '0') * scale;
+                scale *= 0.1;
+            }
+        }
+
+        return p != start and !(p == start + 1 and *start == '.');
+    }
+};
+
+#endif
@@ -0,0 +1,405 @@
+#ifndef ScaleSpace_PACK_HPP
+#define ScaleSpace_PACK_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "ScaleSpaceLibrary.hpp"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Scale packs (.sspack): a whole library of pre-parsed scales in one file that is
+// memory mapped rather than read. Opening a pack only checks its header, so it takes
+// the same time for ten scales or ten thousand; the pages of a record are read from
+// disk the first time it is shown or searched.
+//
+// Layout, in the byte order of the machine that wrote it (checked on open):
+//   PackHeader
+//   PackRecord[record_count]   fixed size, so record i is at records_offset + i * sizeof(PackRecord)
+//   float[tone_count]          every scale's tones in cents, record by record
+//   char[strings_size]         NUL terminated paths and descriptions
+// Sections start on 64 byte boundaries, so fingerprints are aligned for vector loads.
+namespace ScalePackFormat
+{
+    static constexpr char kMagic[4] = { 'S', 'S', 'P', 'K' };
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kByteOrder = 0x01020304;
+
+    struct PackHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t fingerprint_size;
+        uint32_t record_count;
+        uint32_t reserved;
+        uint64_t records_offset;
+        uint64_t tones_offset;
+        uint64_t tone_count;
+        uint64_t strings_offset;
+        uint64_t strings_size;
+    };
+
+    struct PackRecord
+    {
+        uint32_t path;          // offsets into the string table
+        uint32_t name;
+        uint32_t description;
+        uint32_t first_tone;    // index into the tone array
+        uint32_t note_count;
+        float period_cents;
+        uint32_t reserved[2];
+        float fingerprint[ScaleLibrary::kFingerprintSize];
+    };
+
+    static_assert(sizeof(PackHeader) == 64, "pack header layout");
+    static_assert(sizeof(PackRecord) % 16 == 0, "pack records keep fingerprints aligned");
+
+    static inline uint64_t alignUp(const uint64_t offset)
+    {
+        return (offset + 63) & ~static_cast<uint64_t>(63);
+    }
+
+    // Write every record of index to a pack file
+    static inline bool write(const ScaleLibrary::Index& index, const std::string& path)
+    {
+        std::vector<PackRecord> records(index.records.size());
+        std::vector<float> tones;
+        std::string strings(1, '\0');  // offset 0 is the empty string
+
+        auto addString = [&strings](const std::string& text)
+        {
+            const uint32_t offset = static_cast<uint32_t>(strings.size());
+            strings.append(text.c_str(), text.size() + 1);
+            return offset;
+        };
+
+        for (size_t i = 0; i < index.records.size(); i++)
+        {
+            const ScaleLibrary::Record& source = index.records[i];
+            PackRecord& record = records[i];
+            std::memset(&record, 0, sizeof(record));
+
+            record.path = addString(source.path);
+            record.name = record.path + static_cast<uint32_t>(source.path.size() - source.name.size());
+            record.description = source.description.empty() ? 0 : addString(source.description);
+            record.first_tone = static_cast<uint32_t>(tones.size());
+            record.note_count = static_cast<uint32_t>(source.tones.size());
+            record.period_cents = source.period_cents;
+            std::memcpy(record.fingerprint, source.fingerprint, sizeof(record.fingerprint));
+
+            tones.insert(tones.end(), source.tones.begin(), source.tones.end());
+        }
+
+        PackHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, 4);
+        header.version = kVersion;
+        header.byte_order = kByteOrder;
+        header.fingerprint_size = ScaleLibrary::kFingerprintSize;
+        header.record_count = static_cast<uint32_t>(records.size());
+        header.records_offset = alignUp(sizeof(PackHeader));
+        header.tones_offset = alignUp(header.records_offset + records.size() * sizeof(PackRecord));
+        header.tone_count = tones.size();
+        header.strings_offset = alignUp(header.tones_offset + tones.size() * sizeof(float));
+        header.strings_size = strings.size();
+
+        const std::string temporary = ScaleLibrary::temporaryPath(path);
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+
+        if (file == nullptr)
+            return false;
+
+        auto writeAt = [file](const uint64_t offset, const void* data, const size_t size)
+        {
+            static const uint8_t zeros[64] = {};
+            const long position = std::ftell(file);
+
+            if (position >= 0 and static_cast<uint64_t>(position) < offset)
+                std::fwrite(zeros, 1, static_cast<size_t>(offset - position), file);
+
+            std::fwrite(data, 1, size, file);
+        };
+
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.records_offset, records.data(), records.size() * sizeof(PackRecord));
+        writeAt(header.tones_offset, tones.data(), tones.size() * sizeof(float));
+        writeAt(header.strings_offset, strings.data(), strings.size());
+
+        const bool ok = std::ferror(file) == 0;
+        std::fclose(file);
+
+        if (!ok)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        // replaced in one step, so an editor opening the file never finds it missing
+        return ScaleLibrary::replaceFile(temporary, path);
+    }
+}
+
+// A read-only memory mapped pack
+class ScalePack
+{
+public:
+    ScalePack()
+        : data(nullptr),
+          size(0),
+          header(nullptr),
+          records(nullptr),
+          tones(nullptr),
+          strings(nullptr)
+#if defined(_WIN32)
+          , mapping(nullptr)
+#endif
+    {
+    }
+
+    ~ScalePack()
+    {
+        close();
+    }
+
+    ScalePack(const ScalePack&) = delete;
+    ScalePack& operator=(const ScalePack&) = delete;
+
+    bool open(const char* path)
+    {
+        close();
+
+        if (!map(path))
+            return false;
+
+        using namespace ScalePackFormat;
+        header = static_cast<const PackHeader*>(data);
+
+        // Only the header is checked, so opening costs the same for any pack size
+        const bool ok = size >= sizeof(PackHeader)
+                        and std::memcmp(header->magic, kMagic, 4) == 0
+                        and header->version == kVersion
+                        and header->byte_order == kByteOrder
+                        and header->fingerprint_size == ScaleLibrary::kFingerprintSize
+                        and header->records_offset + static_cast<uint64_t>(header->record_count) * sizeof(PackRecord) <= size
+                        and header->tones_offset + header->tone_count * sizeof(float) <= size
+                        and header->strings_size > 0
+                        and header->strings_offset + header->strings_size <= size
+                        and static_cast<const char*>(data)[header->strings_offset + header->strings_size - 1] == '\0';
+
+        if (!ok)
+        {
+            close();
+            return false;
+        }
+
+        records = reinterpret_cast<const PackRecord*>(static_cast<const uint8_t*>(data) + header->records_offset);
+        tones = reinterpret_cast<const float*>(static_cast<const uint8_t*>(data) + header->tones_offset);
+        strings = static_cast<const char*>(data) + header->strings_offset;
+        return true;
+    }
+
+    void close()
+    {
+        unmap();
+        header = nullptr;
+        records = nullptr;
+        tones = nullptr;
+        strings = nullptr;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+    uint32_t getCount() const { return header != nullptr ? header->record_count : 0; }
+
+    // Record i as a library entry; pointers stay valid while the pack is open
+    ScaleLibrary::Entry entry(const uint32_t i) const
+    {
+        const ScalePackFormat::PackRecord& record = records[i];
+        const bool tones_ok = static_cast<uint64_t>(record.first_tone) + record.note_count <= header->tone_count;
+
+        return ScaleLibrary::Entry { string(record.path), string(record.name), string(record.description),
+                                     tones_ok ? static_cast<int32_t>(record.note_count) : 0, record.period_cents,
+                                     record.fingerprint, tones + (tones_ok ? record.first_tone : 0) };
+    }
+
+    // Write record i's tones out as a Scala file in the settings folder, and return its
+    // path, or an empty string on failure. Corners load packed scales from these files,
+    // so a pack still plays after the scales it was built from have moved. The name
+    // carries a hash of the contents, so the same scale always reuses the same file.
+    std::string extractScale(const uint32_t i) const
+    {
+        const ScaleLibrary::Entry source = entry(i);
+
+        if (source.note_count <= 0)
+            return std::string();
+
+        std::string description(source.description[0] != '\0' ? source.description : source.name);
+        std::replace(description.begin(), description.end(), '\n', ' ');
+        std::replace(description.begin(), description.end(), '\r', ' ');
+
+        std::string text = "! " + std::string(source.name) + "\n!\n" + description + "\n "
+                           + std::to_string(source.note_count) + "\n!\n";
+
+        for (int32_t t = 0; t < source.note_count; t++)
+        {
+            char line[32];
+            std::snprintf(line, sizeof(line), " %.6f\n", source.tones[t]);
+            text += line;
+        }
+
+        // 64 bit FNV-1a over the file's text
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (const char c : text)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ULL;
+        }
+
+        char suffix[24];
+        std::snprintf(suffix, sizeof(suffix), "-%016llx.scl", static_cast<unsigned long long>(hash));
+
+        const std::filesystem::path folder = std::filesystem::path(ScaleLibrary::settingsFolder()) / "packed";
+        const std::string path = (folder / (std::filesystem::path(source.name).stem().string() + suffix)).string();
+
+        std::error_code error;
+
+        if (std::filesystem::exists(path, error))
+            return path;
+
+        std::filesystem::create_directories(folder, error);
+
+        const std::string temporary = ScaleLibrary::temporaryPath(path);
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+
+        if (file == nullptr)
+            return std::string();
+
+        const bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+
+        if (std::fclose(file) != 0 or !ok)
+        {
+            std::remove(temporary.c_str());
+            return std::string();
+        }
+
+        return ScaleLibrary::replaceFile(temporary, path) ? path : std::string();
+    }
+
+    // Just the fingerprint of record i, for searching without touching its strings
+    const float* fingerprint(const uint32_t i) const
+    {
+        return records[i].fingerprint;
+    }
+
+private:
+    typedef ScalePackFormat::PackRecord PackRecord;
+
+    const char* string(const uint32_t offset) const
+    {
+        return offset < header->strings_size ? strings + offset : "";
+    }
+
+#if defined(_WIN32)
+    bool map(const char* path)
+    {
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER file_size;
+        const bool sized = GetFileSizeEx(file, &file_size) and file_size.QuadPart > 0;
+        mapping = sized ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+
+        if (mapping == nullptr)
+            return false;
+
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+        if (data == nullptr)
+        {
+            CloseHandle(mapping);
+            mapping = nullptr;
+            return false;
+        }
+
+        size = static_cast<uint64_t>(file_size.QuadPart);
+        return true;
+    }
+
+    void unmap()
+    {
+        if (data != nullptr)
+            UnmapViewOfFile(data);
+
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+
+        data = nullptr;
+        mapping = nullptr;
+        size = 0;
+    }
+#else
+    bool map(const char* path)
+    {
+        const int file = ::open(path, O_RDONLY);
+
+        if (file < 0)
+            return false;
+
+        struct stat info;
+
+        if (fstat(file, &info) != 0 or info.st_size <= 0)
+        {
+            ::close(file);
+            return false;
+        }
+
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+
+        if (mapped == MAP_FAILED)
+            return false;
+
+        data = mapped;
+        size = static_cast<uint64_t>(info.st_size);
+        return true;
+    }
+
+    void unmap()
+    {
+        if (data != nullptr)
+            munmap(const_cast<void*>(data), static_cast<size_t>(size));
+
+        data = nullptr;
+        size = 0;
+    }
+#endif
+
+    const void* data;
+    uint64_t size;
+    const ScalePackFormat::PackHeader* header;
+    const PackRecord* records;
+    const float* tones;
+    const char* strings;
+#if defined(_WIN32)
+    HANDLE mapping;
+#endif
+};
+
+#endif
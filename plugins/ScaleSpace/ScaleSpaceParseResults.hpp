@@ -0,0 +1,74 @@
+#ifndef ScaleSpace_PARSE_RESULTS_HPP
+#define ScaleSpace_PARSE_RESULTS_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "ScaleSpaceControls.hpp"
+#include "ScaleSpaceScaleCache.hpp"
+
+// What loading one .scl or .kbm state produced. The tuning holds the scale and
+// mapping pair actually in use, and its 128 note table; it is the standard tuning
+// when the file failed to load.
+struct ScaleParseResult
+{
+    std::string path;     // the state value this result is for
+    std::string name;     // file name without its folders
+    std::string error;    // empty when the file loaded
+    int32_t note_count;   // scale tones, or mapping size for a .kbm (0 for the standard mapping)
+    ScaleCache::Handle tuning;
+
+    ScaleParseResult()
+        : note_count(0)
+    {
+    }
+
+    void describe(const ScaleCache::Handle& tn, const bool is_scale, const char* value, const char* error_text)
+    {
+        path = value;
+        name = path.substr(path.find_last_of("/\\") + 1);
+        error = error_text != nullptr ? error_text : "";
+        tuning = tn;
+
+        note_count = is_scale ? tn->tuning.scale.count : tn->tuning.keyboardMapping.count;
+    }
+};
+
+// Results of the DSP's setState, per file state. The DSP shares this with its editor
+// through EditorLinks, so a file chosen in the UI is only parsed once. Both sides run
+// setState / stateChanged off the audio thread.
+class ScaleParseResults
+{
+public:
+    ScaleParseResults()
+    {
+        for (uint32_t i = 0; i < kStateCount; i++)
+            valid[i] = false;
+    }
+
+    void publishParseResult(const uint32_t stateId, const ScaleParseResult& result)
+    {
+        std::lock_guard<std::mutex> lock(results_mutex);
+        results[stateId] = result;
+        valid[stateId] = true;
+    }
+
+    // The result for stateId if the DSP has loaded this exact value
+    bool findParseResult(const uint32_t stateId, const char* value, ScaleParseResult& result) const
+    {
+        std::lock_guard<std::mutex> lock(results_mutex);
+
+        if (!valid[stateId] or results[stateId].path != value)
+            return false;
+
+        result = results[stateId];
+        return true;
+    }
+
+private:
+    mutable std::mutex results_mutex;
+    ScaleParseResult results[kStateCount];
+    bool valid[kStateCount];
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef ScaleSpace_PITCH_DETECTOR_HPP
+#define ScaleSpace_PITCH_DETECTOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Block based YIN pitch detector.
+// The YIN difference function is computed from an FFT cross-correlation, and the
+// analysis is split into stages (FFT, inverse FFT, YIN search) that run on
+// successive process() calls, so even 64 frame blocks only ever carry one FFT.
+// All buffers are fixed size members: nothing is allocated after construction.
+class PitchDetector
+{
+public:
+    static constexpr uint32_t kWindowSize = 1024;             // integration window W
+    static constexpr uint32_t kBufferSize = 2 * kWindowSize;  // W plus maximum lag
+    static constexpr uint32_t kFFTSize = kBufferSize;         // large enough that lags up to W never wrap
+    static constexpr uint32_t kHopSize = 512;
+
+    PitchDetector()
+        : sample_rate(48000.0),
+          write_pos(0),
+          samples_since_hop(0),
+          stage(kStageIdle),
+          frequency(0.0f),
+          confidence(0.0f),
+          new_estimate(false)
+    {
+        std::memset(ring, 0, sizeof(ring));
+
+        for (uint32_t k = 0; k < kFFTSize / 2; k++)
+        {
+            const double angle = -2.0 * M_PI * k / kFFTSize;
+            twiddle_re[k] = static_cast<float>(std::cos(angle));
+            twiddle_im[k] = static_cast<float>(std::sin(angle));
+        }
+
+        uint32_t bits = 0;
+        while ((1u << bits) < kFFTSize)
+            bits++;
+
+        for (uint32_t i = 0; i < kFFTSize; i++)
+        {
+            uint32_t reversed = 0;
+            for (uint32_t b = 0; b < bits; b++)
+                reversed |= ((i >> b) & 1) << (bits - 1 - b);
+            bit_reverse[i] = static_cast<uint16_t>(reversed);
+        }
+    }
+
+    void setSampleRate(const double rate)
+    {
+        sample_rate = rate;
+    }
+
+    // Feed a block of input and advance the analysis by at most one stage
+    void process(const float* input, const uint32_t frames)
+    {
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            ring[write_pos] = input[i];
+            write_pos = (write_pos + 1) % kBufferSize;
+        }
+
+        samples_since_hop += frames;
+
+        switch (stage)
+        {
+        case kStageIdle:
+            if (samples_since_hop >= kHopSize)
+            {
+                samples_since_hop = 0;
+                captureFrame();
+                forwardTransform();
+                stage = kStageCorrelate;
+            }
+            break;
+        case kStageCorrelate:
+            inverseCrossSpectrum();
+            stage = kStageSearch;
+            break;
+        case kStageSearch:
+            searchPitch();
+            stage = kStageIdle;
+            break;
+        }
+    }
+
+    // Returns true once for each completed analysis
+    bool hasNewEstimate()
+    {
+        const bool result = new_estimate;
+        new_estimate = false;
+        return result;
+    }
+
+    // Detected fundamental in Hz, or 0 if the last frame was silent or unpitched
+    float getFrequency() const { return frequency; }
+
+    // 1 - YIN aperiodicity of the last estimate
+    float getConfidence() const { return confidence; }
+
+private:
+    enum Stage {
+        kStageIdle,
+        kStageCorrelate,
+        kStageSearch
+    };
+
+    // Copy the ring buffer into chronological order
+    void captureFrame()
+    {
+        const uint32_t tail = kBufferSize - write_pos;
+        std::memcpy(frame, ring + write_pos, tail * sizeof(float));
+        std::memcpy(frame + tail, ring, write_pos * sizeof(float));
+    }
+
+    // Both correlation inputs share one complex FFT:
+    // the window a[0, W) goes in the real part and the full frame b[0, 2W) in the imaginary part.
+    void forwardTransform()
+    {
+        for (uint32_t i = 0; i < kFFTSize; i++)
+        {
+            fft_re[i] = i < kWindowSize ? frame[i] : 0.0f;
+            fft_im[i] = frame[i];
+        }
+
+        fft(fft_re, fft_im);
+    }
+
+    // Split the packed spectrum into A and B, form conj(A) * B and transform back,
+    // leaving r(tau) = sum_j a[j] * b[j + tau] in fft_re.
+    void inverseCrossSpectrum()
+    {
+        for (uint32_t k = 0; k <= kFFTSize / 2; k++)
+        {
+            const uint32_t m = (kFFTSize - k) % kFFTSize;
+
+            const float zk_re = fft_re[k], zk_im = fft_im[k];
+            const float zm_re = fft_re[m], zm_im = fft_im[m];
+
+            // A[k] = (Z[k] + conj(Z[N-k])) / 2, B[k] = (Z[k] - conj(Z[N-k])) / 2i
+            const float a_re = 0.5f * (zk_re + zm_re);
+            const float a_im = 0.5f * (zk_im - zm_im);
+            const float b_re = 0.5f * (zk_im + zm_im);
+            const float b_im = -0.5f * (zk_re - zm_re);
+
+            // conj(A) * B, conjugated again for the inverse transform below
+            const float c_re = a_re * b_re + a_im * b_im;
+            const float c_im = a_re * b_im - a_im * b_re;
+
+            fft_re[k] = c_re;
+            fft_im[k] = -c_im;
+
+            // The correlation is real, so the upper half is the mirror image
+            fft_re[m] = c_re;
+            fft_im[m] = c_im;
+        }
+
+        fft(fft_re, fft_im);
+
+        const float scale = 1.0f / kFFTSize;
+
+        for (uint32_t i = 0; i < kFFTSize; i++)
+            fft_re[i] *= scale;
+    }
+
+    void searchPitch()
+    {
+        new_estimate = true;
+        frequency = 0.0f;
+        confidence = 0.0f;
+
+        const uint32_t min_lag = static_cast<uint32_t>(sample_rate / kMaxFrequency);
+        const uint32_t max_lag = std::min(kWindowSize, static_cast<uint32_t>(sample_rate / kMinFrequency));
+
+        // Energy of the window and of the lagged window, updated as a running sum
+        float window_energy = 0.0f;
+        for (uint32_t j = 0; j < kWindowSize; j++)
+            window_energy += frame[j] * frame[j];
+
+        if (window_energy < kSilenceEnergy * kWindowSize or min_lag < 2 or min_lag >= max_lag)
+            return;
+
+        float lagged_energy = window_energy;
+        difference[0] = 0.0f;
+
+        for (uint32_t tau = 1; tau <= max_lag; tau++)
+        {
+            lagged_energy += frame[tau + kWindowSize - 1] * frame[tau + kWindowSize - 1] - frame[tau - 1] * frame[tau - 1];
+            difference[tau] = window_energy + lagged_energy - 2.0f * fft_re[tau];
+        }
+
+        // Cumulative mean normalised difference
+        float running_sum = 0.0f;
+        for (uint32_t tau = 1; tau <= max_lag; tau++)
+        {
+            running_sum += difference[tau];
+            difference[tau] = running_sum > 0.0f ? difference[tau] * tau / running_sum : 1.0f;
+        }
+
+        // First dip under the threshold, followed down to its local minimum
+        uint32_t best = 0;
+        for (uint32_t tau = min_lag; tau < max_lag; tau++)
+        {
+            if (difference[tau] < kThreshold)
+            {
+                while (tau + 1 < max_lag and difference[tau + 1] < difference[tau])
+                    tau++;
+                best = tau;
+                break;
+            }
+        }
+
+        if (best == 0)
+            return;
+
+        // Parabolic interpolation around the minimum
+        const float left = difference[best - 1];
+        const float centre = difference[best];
+        const float right = difference[best + 1];
+        const float denominator = left - 2.0f * centre + right;
+        const float offset = std::fabs(denominator) > 1.0e-9f ? 0.5f * (left - right) / denominator : 0.0f;
+
+        frequency = static_cast<float>(sample_rate / (best + offset));
+        confidence = 1.0f - centre;
+    }
+
+    // In-place iterative radix-2 FFT on split real/imaginary arrays
+    void fft(float* re, float* im) const
+    {
+        for (uint32_t i = 0; i < kFFTSize; i++)
+        {
+            const uint32_t j = bit_reverse[i];
+            if (j > i)
+            {
+                std::swap(re[i], re[j]);
+                std::swap(im[i], im[j]);
+            }
+        }
+
+        for (uint32_t size = 2; size <= kFFTSize; size *= 2)
+        {
+            const uint32_t half = size / 2;
+            const uint32_t step = kFFTSize / size;
+
+            for (uint32_t start = 0; start < kFFTSize; start += size)
+            {
+                float* const even_re = re + start;
+                float* const even_im = im + start;
+                float* const odd_re = re + start + half;
+                float* const odd_im = im + start + half;
+
+                for (uint32_t k = 0; k < half; k++)
+                {
+                    const float w_re = twiddle_re[k * step];
+                    const float w_im = twiddle_im[k * step];
+                    const float t_re = odd_re[k] * w_re - odd_im[k] * w_im;
+                    const float t_im = odd_re[k] * w_im + odd_im[k] * w_re;
+
+                    odd_re[k] = even_re[k] - t_re;
+                    odd_im[k] = even_im[k] - t_im;
+                    even_re[k] += t_re;
+                    even_im[k] += t_im;
+                }
+            }
+        }
+    }
+
+    static constexpr float kThreshold = 0.15f;
+    static constexpr float kSilenceEnergy = 1.0e-6f;  // mean square, about -60 dBFS
+    static constexpr double kMinFrequency = 40.0;
+    static constexpr double kMaxFrequency = 2000.0;
+
+    double sample_rate;
+    uint32_t write_pos;
+    uint32_t samples_since_hop;
+    Stage stage;
+
+    float frequency;
+    float confidence;
+    bool new_estimate;
+
+    float ring[kBufferSize];
+    float frame[kBufferSize];
+    float fft_re[kFFTSize];
+    float fft_im[kFFTSize];
+    float twiddle_re[kFFTSize / 2];
+    float twiddle_im[kFFTSize / 2];
+    uint16_t bit_reverse[kFFTSize];
+    float difference[kWindowSize + 2];
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef ScaleSpace_PREVIEW_HPP
+#define ScaleSpace_PREVIEW_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Preview voice bank for auditioning the current tuning without an MTS-ESP client.
+// A fixed pool of sine-like voices kept as structure-of-arrays, so the per-sample
+// loop runs across all voices at once and vectorises; free voices simply have zero
+// gain. Nothing is allocated after construction.
+class PreviewVoices
+{
+public:
+    static constexpr uint32_t kVoiceCount = 16;
+
+    PreviewVoices()
+        : sample_rate(48000.0),
+          gain_coefficient(0.0f),
+          next_voice(0)
+    {
+        std::memset(phase, 0, sizeof(phase));
+        std::memset(increment, 0, sizeof(increment));
+        std::memset(gain, 0, sizeof(gain));
+        std::memset(target_gain, 0, sizeof(target_gain));
+        std::memset(pan_left, 0, sizeof(pan_left));
+        std::memset(pan_right, 0, sizeof(pan_right));
+
+        for (uint32_t v = 0; v < kVoiceCount; v++)
+            voice_note[v] = -1;
+
+        setSampleRate(sample_rate);
+    }
+
+    void setSampleRate(const double rate)
+    {
+        sample_rate = rate;
+
+        // About 5 ms attack and release
+        gain_coefficient = static_cast<float>(1.0 - std::exp(-1.0 / (0.005 * rate)));
+    }
+
+    void noteOn(const uint8_t note, const uint8_t velocity)
+    {
+        // Reuse a voice already on this note, otherwise a silent one, otherwise steal round robin
+        int32_t voice = -1;
+
+        for (uint32_t v = 0; v < kVoiceCount and voice < 0; v++)
+        {
+            if (voice_note[v] == note)
+                voice = v;
+        }
+
+        for (uint32_t v = 0; v < kVoiceCount and voice < 0; v++)
+        {
+            if (target_gain[v] == 0.0f and gain[v] < kSilentGain)
+                voice = v;
+        }
+
+        if (voice < 0)
+        {
+            voice = next_voice;
+            next_voice = (next_voice + 1) % kVoiceCount;
+        }
+
+        // Spread notes across the stereo field by pitch
+        const float pan = note / 127.0f;
+
+        voice_note[voice] = note;
+        target_gain[voice] = 0.25f * (velocity / 127.0f);
+        pan_left[voice] = std::sqrt(1.0f - pan);
+        pan_right[voice] = std::sqrt(pan);
+    }
+
+    void noteOff(const uint8_t note)
+    {
+        for (uint32_t v = 0; v < kVoiceCount; v++)
+        {
+            if (voice_note[v] == note)
+            {
+                voice_note[v] = -1;
+                target_gain[v] = 0.0f;
+            }
+        }
+    }
+
+    void allNotesOff()
+    {
+        for (uint32_t v = 0; v < kVoiceCount; v++)
+        {
+            voice_note[v] = -1;
+            target_gain[v] = 0.0f;
+        }
+    }
+
+    // True while any voice is sounding or fading out
+    bool isActive() const
+    {
+        bool active = false;
+
+        for (uint32_t v = 0; v < kVoiceCount; v++)
+            active |= (target_gain[v] > 0.0f) | (gain[v] >= kSilentGain);
+
+        return active;
+    }
+
+    // Follow the current tuning; called once per block
+    void setFrequencies(const double* frequencies)
+    {
+        for (uint32_t v = 0; v < kVoiceCount; v++)
+        {
+            if (voice_note[v] >= 0)
+                increment[v] = static_cast<float>(frequencies[voice_note[v]] / sample_rate);
+        }
+    }
+
+    // Add the voices into left and right, scaled by level
+    void render(float* left, float* right, const uint32_t frames, const float level)
+    {
+        for (uint32_t fr = 0; fr < frames; fr++)
+        {
+            float sum_left = 0.0f;
+            float sum_right = 0.0f;
+
+            for (uint32_t v = 0; v < kVoiceCount; v++)
+            {
+                float p = phase[v] + increment[v];
+                p -= std::floor(p);
+                phase[v] = p;
+
+                // Parabolic sine approximation over one cycle
+                const float x = 2.0f * p - 1.0f;
+                const float wave = 4.0f * x * (1.0f - std::fabs(x));
+
+                gain[v] += (target_gain[v] - gain[v]) * gain_coefficient;
+
+                const float out = wave * gain[v];
+                sum_left += out * pan_left[v];
+                sum_right += out * pan_right[v];
+            }
+
+            left[fr] += sum_left * level;
+            right[fr] += sum_right * level;
+        }
+    }
+
+private:
+    static constexpr float kSilentGain = 1.0e-5f;
+
+    double sample_rate;
+    float gain_coefficient;
+    uint32_t next_voice;
+
+    float phase[kVoiceCount];
+    float increment[kVoiceCount];
+    float gain[kVoiceCount];
+    float target_gain[kVoiceCount];
+    float pan_left[kVoiceCount];
+    float pan_right[kVoiceCount];
+    int32_t voice_note[kVoiceCount];
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef ScaleSpace_SCALE_CACHE_HPP
+#define ScaleSpace_SCALE_CACHE_HPP
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <sys/stat.h>
+#include "Tunings.h"
+
+// Process-wide cache of parsed .scl / .kbm files and of the tunings built from them.
+//
+// Every ScaleSpace instance in the process (DSP and UI) shares one cache, so a file
+// used by dozens of instances is read and parsed once and its tuning is built once.
+// Files are keyed by a hash of their contents; the path, modification time and size
+// are checked first so an unchanged file is not even re-read, unless it was modified so
+// recently that a second write could still share its timestamp. Entries are immutable
+// and reference counted: the cache only holds weak references, so an entry is freed
+// when the last instance using it lets go.
+class ScaleCache
+{
+public:
+    struct Entry
+    {
+        Tunings::Tuning tuning;
+        double frequencies[128];
+        std::shared_ptr<const Tunings::Scale> scale;              // null for the standard scale
+        std::shared_ptr<const Tunings::KeyboardMapping> mapping;  // null for the standard mapping
+        uint64_t scale_hash;                                      // 0 for the standard scale
+        uint64_t mapping_hash;                                    // 0 for the standard mapping
+    };
+
+    typedef std::shared_ptr<const Entry> Handle;
+
+    static ScaleCache& instance()
+    {
+        static ScaleCache cache;
+        return cache;
+    }
+
+    // Standard tuning: 12-EDO with the standard keyboard mapping
+    Handle standard()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return buildTuning(nullptr, 0, nullptr, 0);
+    }
+
+    // current with its scale replaced by the .scl file at path.
+    // Parse and tuning errors are thrown as std::exception, as Tunings does.
+    Handle withScale(const Handle& current, const char* path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint64_t hash = 0;
+        std::shared_ptr<const Tunings::Scale> scale = loadFile(path, hash, scale_files, [](const std::string& data, const char* name)
+        {
+            Tunings::Scale parsed = Tunings::parseSCLData(data);
+            parsed.name = name;
+            return parsed;
+        });
+
+        return buildTuning(scale, hash, current->mapping, current->mapping_hash);
+    }
+
+    // current with its mapping replaced by the .kbm file at path
+    Handle withMapping(const Handle& current, const char* path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint64_t hash = 0;
+        std::shared_ptr<const Tunings::KeyboardMapping> mapping = loadFile(path, hash, mapping_files, [](const std::string& data, const char* name)
+        {
+            Tunings::KeyboardMapping parsed = Tunings::parseKBMData(data);
+            parsed.name = name;
+            return parsed;
+        });
+
+        return buildTuning(current->scale, current->scale_hash, mapping, hash);
+    }
+
+    Handle withStandardScale(const Handle& current)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return buildTuning(nullptr, 0, current->mapping, current->mapping_hash);
+    }
+
+    Handle withStandardMapping(const Handle& current)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return buildTuning(current->scale, current->scale_hash, nullptr, 0);
+    }
+
+private:
+    // Files modified this recently are always re-read; some file systems only keep
+    // modification times to the second, or even to two seconds
+    static constexpr int64_t kRecentSeconds = 2;
+
+    // What was last seen at a path, to skip re-reading unchanged files
+    struct PathRecord
+    {
+        int64_t mtime;          // nanoseconds, where the platform has them
+        int64_t size;
+        uint64_t hash;
+    };
+
+    template <class T>
+    struct FileCache
+    {
+        std::map<std::string, PathRecord> paths;
+        std::map<uint64_t, std::weak_ptr<const T>> contents;
+    };
+
+    ScaleCache() {}
+
+    // 64 bit FNV-1a; never 0, which stands for the standard scale or mapping
+    static uint64_t contentHash(const std::string& data)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (const char c : data)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash != 0 ? hash : 1;
+    }
+
+    template <class T, class Parser>
+    std::shared_ptr<const T> loadFile(const char* path, uint64_t& hash, FileCache<T>& files, Parser parse)
+    {
+        struct stat info;
+
+        if (stat(path, &info) != 0)
+            throw std::runtime_error(std::string("Unable to open file '") + path + "'");
+
+        const int64_t mtime = modifiedNanoseconds(info);
+        const int64_t size = static_cast<int64_t>(info.st_size);
+        const bool settled = static_cast<int64_t>(std::time(nullptr)) - static_cast<int64_t>(info.st_mtime) >= kRecentSeconds;
+
+        // Fast path: same file, unchanged, still in use somewhere
+        auto known = files.paths.find(path);
+
+        if (settled and known != files.paths.end() and known->second.mtime == mtime and known->second.size == size)
+        {
+            auto cached = files.contents.find(known->second.hash);
+
+            if (cached != files.contents.end())
+            {
+                if (std::shared_ptr<const T> parsed = cached->second.lock())
+                {
+                    hash = known->second.hash;
+                    return parsed;
+                }
+            }
+        }
+
+        std::ifstream stream(path, std::ios::in | std::ios::binary);
+
+        if (!stream.is_open())
+            throw std::runtime_error(std::string("Unable to open file '") + path + "'");
+
+        std::stringstream buffer;
+        buffer << stream.rdbuf();
+        const std::string data = buffer.str();
+
+        hash = contentHash(data);
+        files.paths[path] = PathRecord { mtime, size, hash };
+
+        // Same contents under another path
+        auto cached = files.contents.find(hash);
+
+        if (cached != files.contents.end())
+        {
+            if (std::shared_ptr<const T> parsed = cached->second.lock())
+                return parsed;
+        }
+
+        std::shared_ptr<const T> parsed = std::make_shared<const T>(parse(data, path));
+        files.contents[hash] = parsed;
+        prune(files.contents);
+        prunePaths(files);
+        return parsed;
+    }
+
+    static int64_t modifiedNanoseconds(const struct stat& info)
+    {
+#if defined(__APPLE__)
+        return static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+        return static_cast<int64_t>(info.st_mtime) * 1000000000;
+#else
+        return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    }
+
+    // Forget paths whose contents are no longer held, so the path map does not grow
+    // with every file ever opened
+    template <class T>
+    static void prunePaths(FileCache<T>& files)
+    {
+        for (auto it = files.paths.begin(); it != files.paths.end(); )
+        {
+            if (files.contents.find(it->second.hash) == files.contents.end())
+                it = files.paths.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    Handle buildTuning(const std::shared_ptr<const Tunings::Scale>& scale, const uint64_t scale_hash,
+                       const std::shared_ptr<const Tunings::KeyboardMapping>& mapping, const uint64_t mapping_hash)
+    {
+        const std::pair<uint64_t, uint64_t> key(scale_hash, mapping_hash);
+        auto cached = tunings.find(key);
+
+        if (cached != tunings.end())
+        {
+            if (Handle entry = cached->second.lock())
+                return entry;
+        }
+
+        std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+
+        if (scale and mapping)
+            entry->tuning = Tunings::Tuning(*scale, *mapping);
+        else if (scale)
+            entry->tuning = Tunings::Tuning(*scale, Tunings::Tuning().keyboardMapping);
+        else if (mapping)
+            entry->tuning = Tunings::Tuning(Tunings::Tuning().scale, *mapping);
+
+        for (int32_t i = 0; i < 128; i++)
+            entry->frequencies[i] = entry->tuning.frequencyForMidiNote(i);
+
+        entry->scale = scale;
+        entry->mapping = mapping;
+        entry->scale_hash = scale_hash;
+        entry->mapping_hash = mapping_hash;
+
+        tunings[key] = entry;
+        prune(tunings);
+        return entry;
+    }
+
+    // Drop map slots whose entries have been freed
+    template <class Map>
+    static void prune(Map& map)
+    {
+        for (auto it = map.begin(); it != map.end(); )
+        {
+            if (it->second.expired())
+                it = map.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::mutex mutex;
+    FileCache<Tunings::Scale> scale_files;
+    FileCache<Tunings::KeyboardMapping> mapping_files;
+    std::map<std::pair<uint64_t, uint64_t>, std::weak_ptr<const Entry>> tunings;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef ScaleSpace_SEARCH_HPP
+#define ScaleSpace_SEARCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "ScaleSpaceLibrary.hpp"
+
+// Copy of the DSP's current tuning table for the UI. The UI asks for one, the audio
+// thread answers once it has worked out the block's tuning, and the UI takes it; only
+// one copy is ever in flight, so the table needs no lock. With the table comes the key
+// the tuning's period starts on and how many keys one period spans, taken from the
+// scale and mapping that dominate the tuning. The DSP shares this with its editor
+// through EditorLinks, like ScaleParseResults.
+class TuningSnapshot
+{
+public:
+    TuningSnapshot()
+        : requested(false),
+          ready(false),
+          root_note(60),
+          period_keys(12)
+    {
+        std::memset(table, 0, sizeof(table));
+    }
+
+    // UI side
+    void requestSnapshot()
+    {
+        ready.store(false, std::memory_order_relaxed);
+        requested.store(true, std::memory_order_release);
+    }
+
+    // Give up on a request the DSP has not answered (it is not processing audio)
+    void cancelSnapshot()
+    {
+        requested.store(false, std::memory_order_relaxed);
+        ready.store(false, std::memory_order_relaxed);
+    }
+
+    bool takeSnapshot(double* frequencies, int32_t& root, int32_t& keys)
+    {
+        if (!ready.exchange(false, std::memory_order_acquire))
+            return false;
+
+        std::memcpy(frequencies, table, sizeof(table));
+        root = root_note;
+        keys = period_keys;
+        return true;
+    }
+
+    // Audio thread; realtime safe
+    bool isSnapshotRequested() const
+    {
+        return requested.load(std::memory_order_acquire);
+    }
+
+    void publishSnapshot(const double* frequencies, const int32_t root, const int32_t keys)
+    {
+        // each request is answered once
+        if (!requested.exchange(false, std::memory_order_acq_rel))
+            return;
+
+        std::memcpy(table, frequencies, sizeof(table));
+        root_note = root;
+        period_keys = keys;
+        ready.store(true, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool> requested;
+    std::atomic<bool> ready;
+    double table[128];
+    int32_t root_note;
+    int32_t period_keys;
+};
+
+// Nearest scales in the library to a fingerprint. Fingerprints have unit length, so
+// the squared distance is 2 - 2 * (dot product); the dot product runs in independent
+// lanes so the compiler can keep it in vector registers.
+namespace ScaleSearch
+{
+    struct Match
+    {
+        float distance;
+        uint32_t row;
+
+        bool operator<(const Match& other) const
+        {
+            return distance < other.distance;
+        }
+    };
+
+    static inline float distance(const float* a, const float* b)
+    {
+        static constexpr int32_t kLanes = 8;
+        static_assert(ScaleLibrary::kFingerprintSize % kLanes == 0, "fingerprints fill whole lanes");
+
+        float lanes[kLanes] = {};
+
+        for (int32_t i = 0; i < ScaleLibrary::kFingerprintSize; i += kLanes)
+        {
+            for (int32_t l = 0; l < kLanes; l++)
+                lanes[l] += a[i + l] * b[i + l];
+        }
+
+        float dot = 0.0f;
+
+        for (int32_t l = 0; l < kLanes; l++)
+            dot += lanes[l];
+
+        return std::max(0.0f, 2.0f - 2.0f * dot);
+    }
+
+    // Fingerprint of a 128 note table over exactly one period: the keys_per_period keys
+    // from root_note up, against the interval to the key one period above. This folds
+    // the table the same way describeScale folds a scale, so any period and key count
+    // compares like a library scale.
+    static inline void fingerprintTable(const double* frequencies, int32_t root_note, int32_t keys_per_period, float* fingerprint)
+    {
+        keys_per_period = std::min(std::max(keys_per_period, 1), 127);
+        root_note = std::min(std::max(root_note, 0), 127);
+
+        // keep the period above the root on the keyboard, moving down whole periods
+        while (root_note + keys_per_period > 127)
+            root_note = std::max(root_note - keys_per_period, 0);
+
+        const double root = frequencies[root_note];
+        double period = 1200.0 * std::log2(frequencies[root_note + keys_per_period] / root);
+
+        if (!std::isfinite(period) or period <= 0.0)
+            period = 1200.0;
+
+        double cents[128];
+
+        for (int32_t i = 0; i < keys_per_period; i++)
+            cents[i] = 1200.0 * std::log2(frequencies[root_note + i] / root);
+
+        ScaleLibrary::fingerprintPitches(cents, keys_per_period, period, fingerprint);
+    }
+
+    // Keeps the k closest matches offered to it in a max-heap, so each candidate that
+    // is no closer than the current k-th costs a single comparison
+    class TopK
+    {
+    public:
+        explicit TopK(const uint32_t k)
+            : capacity(std::max(k, 1u))
+        {
+            heap.reserve(capacity);
+        }
+
+        void offer(const float distance, const uint32_t row)
+        {
+            if (heap.size() < capacity)
+            {
+                heap.push_back(Match { distance, row });
+                std::push_heap(heap.begin(), heap.end());
+            }
+            else if (distance < heap.front().distance)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = Match { distance, row };
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+
+        // Matches from nearest to furthest; empties the heap
+        std::vector<Match> take()
+        {
+            std::sort_heap(heap.begin(), heap.end());
+            std::vector<Match> matches;
+            matches.swap(heap);
+            return matches;
+        }
+
+    private:
+        uint32_t capacity;
+        std::vector<Match> heap;
+    };
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef ScaleSpace_SYSEX_HPP
+#define ScaleSpace_SYSEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Helpers for MIDI Tuning Standard real-time single note tuning change messages:
+// F0 7F <device> 08 02 <program> <count> [<key> <xx> <yy> <zz>] ... F7
+namespace MtsSysex
+{
+    static constexpr uint32_t kHeaderBytes = 8;  // header, count and F7
+    static constexpr uint32_t kBytesPerNote = 4;
+    static constexpr uint32_t kMaxNotesPerMessage = 16;
+    static constexpr uint32_t kMaxMessageBytes = kHeaderBytes + kBytesPerNote * kMaxNotesPerMessage;
+
+    // A 31.25 kbaud DIN link carries 10 bits per byte
+    static constexpr double kDinBytesPerSecond = 31250.0 / 10.0;
+
+    // 7F 7F 7F means "no change", so the highest word that still retunes is 7F 7F 7E
+    static constexpr double kMaxSemitones = 127.0 + 16382.0 / 16384.0;
+
+    // Convert 128 frequencies to MTS words: semitone in the upper 7 bits and a
+    // 14 bit fraction of a semitone below. Flat loop so the compiler can vectorise it.
+    static inline void frequenciesToWords(const double* frequencies, uint32_t* words)
+    {
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            double semitones = 69.0 + 12.0 * std::log2(frequencies[i] / 440.0);
+            semitones = std::min(std::max(semitones, 0.0), kMaxSemitones);
+            words[i] = static_cast<uint32_t>(semitones * 16384.0 + 0.5);
+        }
+    }
+
+    // Write one message for the given notes into out, returning its size in bytes
+    static inline uint32_t buildMessage(const uint8_t device, const uint8_t program, const uint8_t* notes, const uint32_t count, const uint32_t* words, uint8_t* out)
+    {
+        uint32_t size = 0;
+
+        out[size++] = 0xF0;
+        out[size++] = 0x7F;
+        out[size++] = device & 0x7F;
+        out[size++] = 0x08;
+        out[size++] = 0x02;
+        out[size++] = program & 0x7F;
+        out[size++] = count & 0x7F;
+
+        for (uint32_t n = 0; n < count; n++)
+        {
+            const uint32_t word = words[notes[n]];
+            out[size++] = notes[n] & 0x7F;
+            out[size++] = (word >> 14) & 0x7F;
+            out[size++] = (word >> 7) & 0x7F;
+            out[size++] = word & 0x7F;
+        }
+
+        out[size++] = 0xF7;
+
+        return size;
+    }
+}
+
+#endif
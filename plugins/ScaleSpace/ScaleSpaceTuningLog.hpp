@@ -0,0 +1,478 @@
+#ifndef ScaleSpace_TUNING_LOG_HPP
+#define ScaleSpace_TUNING_LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Tuning log files record every published 128 note table with its sample time.
+//
+// Layout: "SSTL", a version byte and the sample rate as a varint, then one record
+// per published table:
+//   varint   frames since the previous record
+//   16 bytes mask of the notes that changed (little endian, note 0 first)
+//   zigzag varint per changed note: change in pitch, in hundredths of a cent above 440 Hz
+// The first record is taken against an all-zero table, so it carries every note.
+namespace TuningLog
+{
+    static constexpr char kMagic[4] = { 'S', 'S', 'T', 'L' };
+    static constexpr uint8_t kVersion = 1;
+    static constexpr double kUnitsPerCent = 100.0;
+
+    static inline int32_t frequencyToUnits(const double frequency)
+    {
+        const double cents = 1200.0 * std::log2(frequency / 440.0);
+        return std::isfinite(cents) ? static_cast<int32_t>(std::lround(cents * kUnitsPerCent)) : 0;
+    }
+
+    static inline double unitsToFrequency(const int32_t units)
+    {
+        return 440.0 * std::exp2(units / (1200.0 * kUnitsPerCent));
+    }
+
+    static inline uint32_t writeVarint(uint64_t value, uint8_t* out)
+    {
+        uint32_t size = 0;
+
+        while (value >= 0x80)
+        {
+            out[size++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+
+        out[size++] = static_cast<uint8_t>(value);
+        return size;
+    }
+
+    static inline bool readVarint(std::FILE* file, uint64_t& value)
+    {
+        value = 0;
+
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            const int byte = std::fgetc(file);
+
+            if (byte == EOF)
+                return false;
+
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    static inline uint64_t zigzag(const int64_t value)
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static inline int64_t unzigzag(const uint64_t value)
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+}
+
+// Records tables from the audio thread and writes them from its own thread.
+// push() only copies into a single producer / single consumer ring, and drops the
+// table if the ring is full, so the audio thread never waits for the disk.
+// The writer thread only exists while the plugin is active and a log file is set,
+// and it sleeps until logging is switched on.
+class TuningLogWriter
+{
+public:
+    static constexpr uint32_t kCapacity = 128;  // power of two
+
+    TuningLogWriter()
+        : active(false),
+          running(false),
+          enabled(false),
+          write_index(0),
+          read_index(0),
+          dropped(0),
+          path_changed(false),
+          sample_rate(48000.0),
+          file(nullptr),
+          open_pending(false),
+          last_time(0),
+          first_record(true)
+    {
+    }
+
+    ~TuningLogWriter()
+    {
+        deactivate();
+    }
+
+    // Log file to write; an empty path stops writing and ends the writer thread.
+    // Not for the audio thread.
+    void setPath(const char* new_path)
+    {
+        std::lock_guard<std::mutex> control(control_mutex);
+
+        {
+            std::lock_guard<std::mutex> lock(path_mutex);
+            path = new_path != nullptr ? new_path : "";
+            path_changed = true;
+        }
+
+        updateThread();
+        wake.notify_one();
+    }
+
+    // From activate() and deactivate()
+    void activate(const double rate)
+    {
+        std::lock_guard<std::mutex> control(control_mutex);
+
+        if (active)
+            return;
+
+        active = true;
+        sample_rate = rate;
+
+        {
+            // each activation starts a fresh log in the chosen file
+            std::lock_guard<std::mutex> lock(path_mutex);
+            path_changed = true;
+        }
+
+        updateThread();
+    }
+
+    void deactivate()
+    {
+        std::lock_guard<std::mutex> control(control_mutex);
+        active = false;
+        updateThread();
+    }
+
+    // Follow the log switch; realtime safe. Only switching it on wakes the writer.
+    void setEnabled(const bool enable)
+    {
+        if (enable and !enabled.exchange(true, std::memory_order_acq_rel))
+            wake.notify_one();
+        else if (!enable)
+            enabled.store(false, std::memory_order_release);
+    }
+
+    // Queue one table; realtime safe
+    bool push(const uint64_t sample_time, const double* frequencies)
+    {
+        const uint32_t write = write_index.load(std::memory_order_relaxed);
+
+        if (write - read_index.load(std::memory_order_acquire) >= kCapacity)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Record& record = records[write & (kCapacity - 1)];
+        record.sample_time = sample_time;
+        std::memcpy(record.frequencies, frequencies, sizeof(record.frequencies));
+
+        write_index.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Tables lost because the writer fell behind, since the log file was started
+    uint32_t getDroppedCount() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Record
+    {
+        uint64_t sample_time;
+        double frequencies[128];
+    };
+
+    // Start or stop the writer thread to match active and path; control_mutex is held
+    void updateThread()
+    {
+        bool wanted;
+
+        {
+            std::lock_guard<std::mutex> lock(path_mutex);
+            wanted = active and !path.empty();
+        }
+
+        if (wanted == running.load())
+            return;
+
+        if (wanted)
+        {
+            running.store(true);
+            thread = std::thread(&TuningLogWriter::threadLoop, this);
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(path_mutex);
+                running.store(false);
+            }
+
+            wake.notify_one();
+            thread.join();
+        }
+    }
+
+    void threadLoop()
+    {
+        while (running.load())
+        {
+            drain();
+
+            std::unique_lock<std::mutex> lock(path_mutex);
+
+            if (enabled.load(std::memory_order_acquire))
+            {
+                wake.wait_for(lock, std::chrono::milliseconds(kDrainMilliseconds));
+            }
+            else
+            {
+                // run() cannot take the lock to notify, so a wake-up can slip past
+                // between the check and the wait; the long timeout covers that
+                wake.wait_for(lock, std::chrono::seconds(kIdleSeconds), [this]() {
+                    return !running.load() or path_changed or enabled.load(std::memory_order_acquire);
+                });
+            }
+        }
+
+        drain();
+        closeFile();
+    }
+
+    void drain()
+    {
+        {
+            std::lock_guard<std::mutex> lock(path_mutex);
+
+            if (path_changed)
+            {
+                closeFile();
+                path_changed = false;
+                open_pending = !path.empty();
+                dropped.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        uint32_t read = read_index.load(std::memory_order_relaxed);
+        const uint32_t write = write_index.load(std::memory_order_acquire);
+
+        // The file is only created (and any old log replaced) once there is something to write
+        if (read != write and open_pending)
+        {
+            std::lock_guard<std::mutex> lock(path_mutex);
+            openFile(path.c_str());
+            open_pending = false;
+        }
+
+        while (read != write)
+        {
+            if (file != nullptr)
+                writeRecord(records[read & (kCapacity - 1)]);
+
+            read++;
+            read_index.store(read, std::memory_order_release);
+        }
+
+        if (file != nullptr)
+            std::fflush(file);
+    }
+
+    void openFile(const char* file_path)
+    {
+        file = std::fopen(file_path, "wb");
+
+        if (file == nullptr)
+            return;
+
+        uint8_t header[16];
+        uint32_t size = 0;
+        std::memcpy(header, TuningLog::kMagic, 4);
+        size += 4;
+        header[size++] = TuningLog::kVersion;
+        size += TuningLog::writeVarint(static_cast<uint64_t>(std::lround(sample_rate)), header + size);
+        std::fwrite(header, 1, size, file);
+
+        std::memset(previous_units, 0, sizeof(previous_units));
+        last_time = 0;
+        first_record = true;
+    }
+
+    void closeFile()
+    {
+        if (file != nullptr)
+            std::fclose(file);
+
+        file = nullptr;
+    }
+
+    void writeRecord(const Record& record)
+    {
+        // varint time, mask and at most 128 varints of up to 5 bytes each
+        uint8_t buffer[10 + 16 + 128 * 5];
+        uint32_t size = 0;
+
+        const uint64_t delta_time = first_record ? 0 : record.sample_time - last_time;
+        size += TuningLog::writeVarint(delta_time, buffer + size);
+
+        int32_t units[128];
+        uint64_t mask[2] = { 0, 0 };
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            units[i] = TuningLog::frequencyToUnits(record.frequencies[i]);
+            mask[i >> 6] |= static_cast<uint64_t>(units[i] != previous_units[i]) << (i & 63);
+        }
+
+        if (!first_record and (mask[0] | mask[1]) == 0)
+            return;
+
+        for (uint32_t b = 0; b < 16; b++)
+            buffer[size++] = static_cast<uint8_t>(mask[b >> 3] >> ((b & 7) * 8));
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            if ((mask[i >> 6] >> (i & 63)) & 1)
+            {
+                size += TuningLog::writeVarint(TuningLog::zigzag(static_cast<int64_t>(units[i]) - previous_units[i]), buffer + size);
+                previous_units[i] = units[i];
+            }
+        }
+
+        std::fwrite(buffer, 1, size, file);
+        last_time = record.sample_time;
+        first_record = false;
+    }
+
+    static constexpr int kDrainMilliseconds = 20;
+    static constexpr int kIdleSeconds = 1;
+
+    std::mutex control_mutex;
+    bool active;
+    std::atomic<bool> running;
+    std::atomic<bool> enabled;
+    std::thread thread;
+    std::condition_variable wake;
+
+    Record records[kCapacity];
+    std::atomic<uint32_t> write_index;
+    std::atomic<uint32_t> read_index;
+    std::atomic<uint32_t> dropped;
+
+    std::mutex path_mutex;
+    std::string path;
+    bool path_changed;
+
+    // writer thread only
+    double sample_rate;
+    std::FILE* file;
+    bool open_pending;
+    int32_t previous_units[128];
+    uint64_t last_time;
+    bool first_record;
+};
+
+// Reads a tuning log back one full table at a time, for replaying or plotting
+class TuningLogReader
+{
+public:
+    TuningLogReader()
+        : file(nullptr),
+          sample_rate(0.0),
+          sample_time(0)
+    {
+        std::memset(units, 0, sizeof(units));
+    }
+
+    ~TuningLogReader()
+    {
+        close();
+    }
+
+    bool open(const char* path)
+    {
+        close();
+        file = std::fopen(path, "rb");
+
+        if (file == nullptr)
+            return false;
+
+        char magic[4];
+        uint64_t rate = 0;
+
+        if (std::fread(magic, 1, 4, file) != 4 or std::memcmp(magic, TuningLog::kMagic, 4) != 0
+            or std::fgetc(file) != TuningLog::kVersion or !TuningLog::readVarint(file, rate))
+        {
+            close();
+            return false;
+        }
+
+        sample_rate = static_cast<double>(rate);
+        sample_time = 0;
+        std::memset(units, 0, sizeof(units));
+        return true;
+    }
+
+    void close()
+    {
+        if (file != nullptr)
+            std::fclose(file);
+
+        file = nullptr;
+    }
+
+    double getSampleRate() const { return sample_rate; }
+
+    // Read the next table; time is in samples since the first record
+    bool next(uint64_t& time, double* frequencies)
+    {
+        if (file == nullptr)
+            return false;
+
+        uint64_t delta_time = 0;
+        uint8_t mask_bytes[16];
+
+        if (!TuningLog::readVarint(file, delta_time) or std::fread(mask_bytes, 1, 16, file) != 16)
+            return false;
+
+        for (uint32_t i = 0; i < 128; i++)
+        {
+            if ((mask_bytes[i >> 3] >> (i & 7)) & 1)
+            {
+                uint64_t value = 0;
+
+                if (!TuningLog::readVarint(file, value))
+                    return false;
+
+                units[i] += static_cast<int32_t>(TuningLog::unzigzag(value));
+            }
+
+            frequencies[i] = TuningLog::unitsToFrequency(units[i]);
+        }
+
+        sample_time += delta_time;
+        time = sample_time;
+        return true;
+    }
+
+private:
+    std::FILE* file;
+    double sample_rate;
+    uint64_t sample_time;
+    int32_t units[128];
+};
+
+#endif
@@ -14,11 +14,20 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <chrono>
 #include <string>
+#include <vector>
+#include "DistrhoPlugin.hpp"
 #include "DistrhoUI.hpp"
 #include "ResizeHandle.hpp"
 #include "extra/String.hpp"
+#include "ScaleSpaceAtlas.hpp"
 #include "ScaleSpaceControls.hpp"
+#include "ScaleSpaceEditorLink.hpp"
+#include "ScaleSpaceLibrary.hpp"
+#include "ScaleSpacePack.hpp"
+#include "ScaleSpaceOverrides.hpp"
+#include "ScaleSpaceScaleCache.hpp"
 #include "BrunoAceFont.hpp"
 #include "BrunoAceSCFont.hpp"
 #include "LektonRegularFont.hpp"
@@ -37,8 +46,47 @@ const char* kStateKeys[kStateCount] = {
     "kbm_file_3",
     "kbm_file_4",
     "file_save_path",
+    "scl_file_grid",
+    "kbm_file_grid",
+    "slot_scl_1",
+    "slot_scl_2",
+    "slot_scl_3",
+    "slot_scl_4",
+    "slot_kbm_1",
+    "slot_kbm_2",
+    "slot_kbm_3",
+    "slot_kbm_4",
+    "note_overrides",
+    "log_file",
+    "library_folders",
+    "library_pack",
+    "atlas_file",
 };
 
+// The KBM state paired with an SCL state, and vice versa
+static States pairedState(const States stateId)
+{
+    switch (stateId)
+    {
+    case kStateFileSCLGrid:
+        return kStateFileKBMGrid;
+    case kStateFileKBMGrid:
+        return kStateFileSCLGrid;
+    case kStateFileSCLSlot1:
+    case kStateFileSCLSlot2:
+    case kStateFileSCLSlot3:
+    case kStateFileSCLSlot4:
+        return static_cast<States>(stateId + kSlotCount);
+    case kStateFileKBMSlot1:
+    case kStateFileKBMSlot2:
+    case kStateFileKBMSlot3:
+    case kStateFileKBMSlot4:
+        return static_cast<States>(stateId - kSlotCount);
+    default:
+        return stateId < kStateFileKBM1 ? static_cast<States>(stateId + 4) : static_cast<States>(stateId - 4);
+    }
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 
 class ScaleSpaceUI : public UI
@@ -72,10 +120,18 @@ public:
 			fFileBaseName[i] = d;
 		}
 		
-		utuning1 = Tunings::Tuning(); 
-		utuning2 = Tunings::Tuning(); 
-		utuning3 = Tunings::Tuning(); 
-		utuning4 = Tunings::Tuning(); 
+		utuning1 = ScaleCache::instance().standard();
+		utuning2 = utuning1;
+		utuning3 = utuning1;
+		utuning4 = utuning1;
+		utuningGrid = utuning1;
+		
+		for (int32_t s = 0; s < kSlotCount; s++)
+			utuningSlot[s] = utuning1;
+		
+		generatorCorner = 0;
+		overrideNote = 60;
+		overrideFrequency = 261.6256;
         
         // account for scaling
         scale_factor = getScaleFactor();
@@ -86,6 +142,15 @@ public:
         
         // Set file_browser_open to sensible default
         file_browser_open = false;
+        file_browser_target = kBrowseExport;
+        
+        // No folders yet; stateChanged loads the index kept for the chosen folders
+        fLibraryIndexPath = ScaleLibrary::indexPathFor(std::vector<std::string>());
+        fLibraryFilter[0] = '\0';
+        libraryCorner = 1;
+        similarPending = false;
+        fEditorLinkId = 0;
+        updateLibraryView();
         
         // Setup fonts
         ImGuiIO& io = ImGui::GetIO();
@@ -150,11 +215,11 @@ public:
         uistyle.Colors[ImGuiCol_ResizeGrip] = light_orange;
         uistyle.Colors[ImGuiCol_ResizeGripHovered] = medium_orange;
         uistyle.Colors[ImGuiCol_ResizeGripActive] = pale_orange;
-        uistyle.Colors[ImGuiCol_Tab] = black;
-        uistyle.Colors[ImGuiCol_TabHovered] = black;
-        uistyle.Colors[ImGuiCol_TabActive] = black;
-        uistyle.Colors[ImGuiCol_TabUnfocused] = black;
-        uistyle.Colors[ImGuiCol_TabUnfocusedActive] = black;
+        uistyle.Colors[ImGuiCol_Tab] = light_orange;
+        uistyle.Colors[ImGuiCol_TabHovered] = medium_orange;
+        uistyle.Colors[ImGuiCol_TabActive] = pale_orange;
+        uistyle.Colors[ImGuiCol_TabUnfocused] = light_orange;
+        uistyle.Colors[ImGuiCol_TabUnfocusedActive] = pale_orange;
         uistyle.Colors[ImGuiCol_PlotLines] = black;
         uistyle.Colors[ImGuiCol_PlotLinesHovered] = black;
         uistyle.Colors[ImGuiCol_PlotHistogram] = black;
@@ -186,6 +251,60 @@ protected:
 		
         repaint();
     }
+    
+    // Collect a finished library scan, and keep its progress display moving
+    void uiIdle() override
+    {
+        if (fLibraryScanner.takeResult(fLibrary))
+        {
+            fSimilar.clear();
+            updateLibraryView();
+            repaint();
+        }
+        
+        // a finished atlas build goes to the DSP, which loads the same file; the path
+        // names the library it was built from and is kept in the atlas_file state
+        std::string atlasPath;
+        
+        if (fAtlasBuilder.takeFinished(atlasPath))
+        {
+            if (atlasPath.empty())
+            {
+                errorText = "Could not save the scale atlas.";
+                show_error_popup = true;
+            }
+            else
+            {
+                setState("atlas_file", atlasPath.c_str());
+                stateChanged("atlas_file", atlasPath.c_str());
+            }
+        }
+        
+        EditorLink* const snapshot = similarPending ? editorLink() : nullptr;
+        double table[128];
+        int32_t root_note = 0;
+        int32_t period_keys = 0;
+        
+        if (snapshot != nullptr and snapshot->takeSnapshot(table, root_note, period_keys))
+        {
+            findSimilarScales(table, root_note, period_keys);
+            similarPending = false;
+            repaint();
+        }
+        else if (snapshot != nullptr and std::chrono::steady_clock::now() - similarRequested > std::chrono::seconds(kSimilarTimeoutSeconds))
+        {
+            // the DSP only answers from run(), which hosts stop calling when transport or audio is off
+            snapshot->cancelSnapshot();
+            similarPending = false;
+            errorText = "The plugin did not send its tuning.\nFind Similar needs the host to be processing audio.";
+            show_error_popup = true;
+            repaint();
+        }
+        else if (fLibraryScanner.isBusy() or fAtlasBuilder.isBusy())
+        {
+            repaint();
+        }
+    }
 
    /**
       A state has changed on the plugin side.@n
@@ -211,6 +330,84 @@ protected:
             stateId = kStateFileKBM3;
         else if (std::strcmp(key, "kbm_file_4") == 0)
             stateId = kStateFileKBM4;
+        else if (std::strcmp(key, "scl_file_grid") == 0)
+            stateId = kStateFileSCLGrid;
+        else if (std::strcmp(key, "kbm_file_grid") == 0)
+            stateId = kStateFileKBMGrid;
+        else if (std::strcmp(key, "note_overrides") == 0)
+        {
+            fOverrides.parse(value);
+            fOverridesText = fOverrides.serialise();
+            repaint();
+            return;
+        }
+        else if (std::strcmp(key, "log_file") == 0)
+        {
+            fState[kStateLogFile] = value;
+            repaint();
+            return;
+        }
+        else if (std::strcmp(key, "library_folders") == 0)
+        {
+            fState[kStateLibraryFolders] = value;
+            
+            // each set of folders keeps its own index from the last scan
+            const std::vector<std::string> folders = ScaleLibrary::splitFolders(value);
+            const std::string index_path = ScaleLibrary::indexPathFor(folders);
+            
+            if (index_path != fLibraryIndexPath)
+            {
+                fLibraryIndexPath = index_path;
+                fLibrary.load(fLibraryIndexPath);
+                fSimilar.clear();
+                updateLibraryView();
+            }
+            
+            // picks up files added or changed since the index was saved; unchanged files are not re-read
+            fLibraryScanner.start(folders, fLibrary, fLibraryIndexPath);
+            repaint();
+            return;
+        }
+        else if (std::strcmp(key, "library_pack") == 0)
+        {
+            fState[kStateLibraryPack] = value;
+            
+            if (value[0] == '\0')
+                fLibraryPack.close();
+            else if (!fLibraryPack.open(value))
+            {
+                errorText = "Could not open scale pack:\n" + String(value);
+                show_error_popup = true;
+            }
+            
+            fSimilar.clear();
+            updateLibraryView();
+            repaint();
+            return;
+        }
+        else if (std::strcmp(key, "atlas_file") == 0)
+        {
+            fState[kStateAtlasFile] = value;
+            
+            if (value[0] == '\0')
+                fAtlas.clear();
+            else if (!fAtlas.load(value))
+            {
+                errorText = "Could not open scale atlas:\n" + String(value);
+                show_error_popup = true;
+            }
+            
+            repaint();
+            return;
+        }
+        else
+        {
+            for (int32_t i = kStateFileSCLSlot1; i <= kStateFileKBMSlot4; i++)
+            {
+                if (std::strcmp(key, kStateKeys[i]) == 0)
+                    stateId = static_cast<States>(i);
+            }
+        }
             
         if (stateId == kStateFileSavePath)
             return;
@@ -254,43 +451,92 @@ protected:
 		{
 			checkKbm(utuning4, value, stateId);
 		}
+		else if (stateId == kStateFileSCLGrid)
+		{
+			checkScl(utuningGrid, value, stateId);
+		}
+		else if (stateId == kStateFileKBMGrid)
+		{
+			checkKbm(utuningGrid, value, stateId);
+		}
+		else if (stateId >= kStateFileSCLSlot1 and stateId <= kStateFileSCLSlot4)
+		{
+			checkScl(utuningSlot[stateId - kStateFileSCLSlot1], value, stateId);
+		}
+		else if (stateId >= kStateFileKBMSlot1 and stateId <= kStateFileKBMSlot4)
+		{
+			checkKbm(utuningSlot[stateId - kStateFileKBMSlot1], value, stateId);
+		}
 	
         repaint();
     }
 	
-	void checkScl(Tunings::Tuning & tn, const char* value, const States & stateId)
+	// The DSP publishes what it made of each file, so when the UI runs in the same
+	// process it just reads that result. Otherwise the file is parsed through the
+	// process-wide cache, which still shares the work between instances.
+	bool findDspParseResult(const States stateId, const char* value, ScaleParseResult& result)
+	{
+		const EditorLink* const link = editorLink();
+		return link != nullptr and link->findParseResult(stateId, value, result);
+	}
+	
+	// What the DSP shares with this editor, or null until its id has arrived, and
+	// always when the UI runs apart from it
+	EditorLink* editorLink()
+	{
+		const uint32_t id = static_cast<uint32_t>(fParameters[kParameterEditorLink] + 0.5f);
+		
+		if (fEditorLink == nullptr or id != fEditorLinkId)
+		{
+			fEditorLinkId = id;
+			fEditorLink = id != 0 ? EditorLinks::instance().find(id) : nullptr;
+		}
+		
+		return fEditorLink.get();
+	}
+	
+	void checkScl(ScaleCache::Handle & tn, const char* value, const States & stateId)
     {
 		String filename(value);
-		auto k = tn.keyboardMapping;
 		
 		if (filename.endsWith(".scl"))
 		{
-			try
-			{   auto s = Tunings::readSCLFile(value);
-				tn = Tunings::Tuning(s, k);
-                const char *a = tn.scale.name.c_str();
-                fFileBaseName[stateId] = getFileBaseName(a);
+			ScaleParseResult result;
+			
+			if (!findDspParseResult(stateId, value, result))
+			{
+				try
+				{
+					result.describe(ScaleCache::instance().withScale(tn, value), true, value, nullptr);
+				}
+				catch (const std::exception& e)
+				{
+					result.describe(ScaleCache::instance().standard(), true, value, e.what());
+				}
 			}
-			catch (const std::exception& e)
+			
+			tn = result.tuning;
+			
+			if (result.error.empty())
+			{
+				fFileBaseName[stateId] = String(result.name.c_str());
+			}
+			else
 			{
-				tn = Tunings::Tuning();
 				String noScl("Standard SCL tuning");
                 String noKbm("Standard KBM mapping");
                 fFileBaseName[stateId] = noScl;
-                fFileBaseName[stateId+4] = noKbm;
-                String tuningError(e.what());
+                fFileBaseName[pairedState(stateId)] = noKbm;
+                String tuningError(result.error.c_str());
                 errorText = "Tuning error:\n" + tuningError + "\nScale reset to standard tuning and mapping.";
                 setState(kStateKeys[stateId], "");
-				setState(kStateKeys[stateId+4], "");
+				setState(kStateKeys[pairedState(stateId)], "");
                 show_error_popup = true;
-                //d_stdout("UI:");
-                //d_stdout(e.what());
 			}
 		}
 		else
 		{
-			auto s = Tunings::Tuning().scale;
-			tn = Tunings::Tuning(s, k);
+			tn = ScaleCache::instance().withStandardScale(tn);
 			String noScl("Standard SCL tuning");
 			fFileBaseName[stateId] = noScl;
 			
@@ -303,39 +549,48 @@ protected:
 		}
 	}
 	
-	void checkKbm(Tunings::Tuning & tn, const char* value, const States & stateId)
+	void checkKbm(ScaleCache::Handle & tn, const char* value, const States & stateId)
 	{
 		String filename(value);
-		auto s = tn.scale;
+		
 		if (filename.endsWith(".kbm"))
 		{
-			try
+			ScaleParseResult result;
+			
+			if (!findDspParseResult(stateId, value, result))
+			{
+				try
+				{
+					result.describe(ScaleCache::instance().withMapping(tn, value), false, value, nullptr);
+				}
+				catch (const std::exception& e)
+				{
+					result.describe(ScaleCache::instance().standard(), false, value, e.what());
+				}
+			}
+			
+			tn = result.tuning;
+			
+			if (result.error.empty())
 			{
-				auto k = Tunings::readKBMFile(value);
-				tn = Tunings::Tuning(s, k);
-				const char *a = tn.keyboardMapping.name.c_str();
-                fFileBaseName[stateId] = getFileBaseName(a);
+				fFileBaseName[stateId] = String(result.name.c_str());
 			}
-			catch (const std::exception& e)
+			else
 			{
-				tn = Tunings::Tuning();
 				String noScl("Standard SCL tuning");
                 String noKbm("Standard KBM mapping");
-                fFileBaseName[stateId - 4] = noScl;
+                fFileBaseName[pairedState(stateId)] = noScl;
                 fFileBaseName[stateId] = noKbm;
-                String tuningError(e.what());
+                String tuningError(result.error.c_str());
                 errorText = "Tuning error:\n" + tuningError + "\nScale reset to standard tuning and mapping.";
                 setState(kStateKeys[stateId], "");
-				setState(kStateKeys[stateId-4], "");
+				setState(kStateKeys[pairedState(stateId)], "");
                 show_error_popup = true;
-                //d_stdout("UI:");
-                //d_stdout(e.what());
 			}
 		}
 		else
 		{
-			auto k = Tunings::Tuning().keyboardMapping;
-			tn = Tunings::Tuning(s, k);
+			tn = ScaleCache::instance().withStandardMapping(tn);
 			String noKbm("Standard KBM mapping");
 			fFileBaseName[stateId] = noKbm;
 			
@@ -348,16 +603,211 @@ protected:
 		}
 	}
 	
-    String getFileBaseName(const char* value)
+    ScaleLibrary::Entry libraryEntry(const uint32_t row) const
+    {
+        if (row & kLibraryPackRow)
+            return fLibraryPack.entry(row & ~kLibraryPackRow);
+        
+        return ScaleLibrary::entryFor(fLibrary.records[row]);
+    }
+    
+    // Rebuild the list of library rows whose name or description contains the filter text
+    void updateLibraryView()
+    {
+        std::string filter(fLibraryFilter);
+        std::transform(filter.begin(), filter.end(), filter.begin(), [](unsigned char c) { return std::tolower(c); });
+        
+        fLibraryView.clear();
+        
+        const uint32_t indexCount = static_cast<uint32_t>(fLibrary.records.size());
+        const uint32_t packCount = fLibraryPack.getCount();
+        
+        for (uint32_t i = 0; i < indexCount + packCount; i++)
+        {
+            const uint32_t row = i < indexCount ? i : (i - indexCount) | kLibraryPackRow;
+            
+            if (filter.empty())
+            {
+                fLibraryView.push_back(row);
+                continue;
+            }
+            
+            const ScaleLibrary::Entry entry = libraryEntry(row);
+            std::string text = std::string(entry.name) + " " + entry.description;
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+            
+            if (text.find(filter) != std::string::npos)
+                fLibraryView.push_back(row);
+        }
+    }
+    
+    // Rank the whole library (index and pack) by distance from the fingerprint of table
+    void findSimilarScales(const double* table, const int32_t root_note, const int32_t period_keys)
+    {
+        float query[ScaleLibrary::kFingerprintSize];
+        ScaleSearch::fingerprintTable(table, root_note, period_keys, query);
+        ScaleSearch::TopK best(kSimilarCount);
+        
+        for (uint32_t i = 0; i < fLibrary.records.size(); i++)
+            best.offer(ScaleSearch::distance(query, fLibrary.records[i].fingerprint), i);
+        
+        for (uint32_t i = 0; i < fLibraryPack.getCount(); i++)
+            best.offer(ScaleSearch::distance(query, fLibraryPack.fingerprint(i)), i | kLibraryPackRow);
+        
+        fSimilar = best.take();
+    }
+    
+    // Build the atlas from the whole library (index and pack) on the builder's thread
+    void buildAtlas()
+    {
+        std::vector<ScaleLibrary::Record> records(fLibrary.records);
+        records.reserve(records.size() + fLibraryPack.getCount());
+        
+        for (uint32_t i = 0; i < fLibraryPack.getCount(); i++)
+            records.push_back(ScaleLibrary::recordFor(fLibraryPack.entry(i)));
+        
+        if (records.size() < 2)
+        {
+            errorText = "The atlas needs at least two library scales.";
+            show_error_popup = true;
+            return;
+        }
+        
+        fAtlasBuilder.start(std::move(records));
+    }
+    
+    // Atlas points over the pad, mapped like the puck, with the scales being blended marked.
+    // The blend follows the DSP's position after pitch tracking and glide, not the raw pad.
+    void drawAtlas(const ImVec2& padMin, const ImVec2& padMax)
+    {
+        ImDrawList* const drawList = ImGui::GetWindowDrawList();
+        const ImVec2 size(padMax.x - padMin.x, padMax.y - padMin.y);
+        const float dot = 1.0f * scale_factor;
+        
+        auto toScreen = [&](const float x, const float y)
+        {
+            return ImVec2(padMin.x + (x + 1.0f) * 0.5f * size.x, padMin.y + (1.0f - y) * 0.5f * size.y);
+        };
+        
+        for (uint32_t i = 0; i < fAtlas.getCount(); i++)
+        {
+            const ImVec2 point = toScreen(fAtlas.getX(i), fAtlas.getY(i));
+            drawList->AddRectFilled(ImVec2(point.x - dot, point.y - dot), ImVec2(point.x + dot, point.y + dot), IM_COL32(200, 200, 200, 120));
+        }
+        
+        const float u = 2.0f * (fParameters[kParameterTrackedX] - controlLimits[kParameterX].first) / (controlLimits[kParameterX].second - controlLimits[kParameterX].first) - 1.0f;
+        const float v = 2.0f * (fParameters[kParameterTrackedY] - controlLimits[kParameterY].first) / (controlLimits[kParameterY].second - controlLimits[kParameterY].first) - 1.0f;
+        const uint32_t neighbours = static_cast<uint32_t>(std::lround(fParameters[kParameterAtlasNeighbours]));
+        uint32_t rows[ScaleAtlas::kMaxNeighbours];
+        float distances[ScaleAtlas::kMaxNeighbours];
+        const uint32_t found = fAtlas.nearest(u, v, neighbours, rows, distances);
+        
+        for (uint32_t n = 0; n < found; n++)
+            drawList->AddCircle(toScreen(fAtlas.getX(rows[n]), fAtlas.getY(rows[n])), 4.0f * scale_factor, IM_COL32(255, 128, 64, 255));
+        
+        // name the scale nearest the puck
+        if (found > 0)
+        {
+            const std::string name = ScaleLibrary::baseName(fAtlas.getPath(rows[0]));
+            drawList->AddText(ImVec2(padMin.x + 4.0f * scale_factor, padMax.y - ImGui::GetTextLineHeight() - 4.0f * scale_factor),
+                              IM_COL32(255, 255, 255, 200), name.c_str());
+        }
+    }
+    
+    // Load a library scale into a corner, as if it had been chosen with the corner's file button.
+    // Packed scales are played from the pack's own tones, not from the files it was built from.
+    void loadLibraryScale(const uint32_t row, const int corner)
     {
-        std::string p(value);
-        // TODO Find a better way to derive the file name!
-        p = p.substr(p.find_last_of("/\\") +1);
-        const char *a = p.c_str();
-        String baseName(a);
-        return baseName;
+        const std::string path = (row & kLibraryPackRow) ? fLibraryPack.extractScale(row & ~kLibraryPackRow) : libraryEntry(row).path;
+        
+        if (path.empty())
+        {
+            errorText = "Could not load the scale from the pack.";
+            show_error_popup = true;
+            return;
+        }
+        
+        const char* const key = kStateKeys[kStateFileSCL1 + corner - 1];
+        setState(key, path.c_str());
+        stateChanged(key, path.c_str());
     }
     
+    // Send the edited pins to the DSP, keeping the text shown on the Pins tab
+    void sendOverrides()
+    {
+        fOverridesText = fOverrides.serialise();
+        setState("note_overrides", fOverridesText.c_str());
+    }
+    
+    // Slider bound to a plugin parameter, with host edit gestures
+    void parameterSlider(const char* label, const Parameters index, const char* format = "%.2f")
+    {
+        if (ImGui::SliderFloat(label, &fParameters[index], controlLimits[index].first, controlLimits[index].second, format))
+            setParameterValue(index, fParameters[index]);
+        
+        if (ImGui::IsItemActivated())
+            editParameter(index, true);
+        
+        if (ImGui::IsItemDeactivated())
+            editParameter(index, false);
+    }
+    
+    // Checkbox bound to a boolean plugin parameter
+    void parameterCheckbox(const char* label, const Parameters index)
+    {
+        bool checked = fParameters[index] > 0.5f;
+        
+        if (ImGui::Checkbox(label, &checked))
+        {
+            fParameters[index] = checked ? 1.0f : 0.0f;
+            editParameter(index, true);
+            setParameterValue(index, fParameters[index]);
+            editParameter(index, false);
+        }
+    }
+    
+    // Combo box bound to an integer (enumerated) plugin parameter
+    void parameterCombo(const char* label, const Parameters index, const char* const items[], const int itemCount)
+    {
+        int current = static_cast<int>(fParameters[index]);
+        
+        if (ImGui::Combo(label, &current, items, itemCount))
+        {
+            fParameters[index] = static_cast<float>(current);
+            editParameter(index, true);
+            setParameterValue(index, fParameters[index]);
+            editParameter(index, false);
+        }
+    }
+    
+    // Name shown in a corner's box: its SCL file, or a description of its generator
+    const char* cornerSclLabel(const int32_t corner, const States sclState)
+    {
+        const int32_t base = kParameterGenerator1 + corner * kGeneratorStride;
+        const float size = fParameters[base + 1];
+        const float interval = fParameters[base + 2];
+        const float period = fParameters[base + 3];
+        
+        switch (static_cast<int32_t>(fParameters[base]))
+        {
+        case kGeneratorEDO:
+            std::snprintf(fGeneratorLabel[corner], sizeof(fGeneratorLabel[corner]), "%.2f-EDO of %.1f cents", size, period);
+            break;
+        case kGeneratorHarmonic:
+            std::snprintf(fGeneratorLabel[corner], sizeof(fGeneratorLabel[corner]), "Harmonics from %.2f", size);
+            break;
+        case kGeneratorSubharmonic:
+            std::snprintf(fGeneratorLabel[corner], sizeof(fGeneratorLabel[corner]), "Subharmonics from %.2f", size);
+            break;
+        case kGeneratorMOS:
+            std::snprintf(fGeneratorLabel[corner], sizeof(fGeneratorLabel[corner]), "MOS %.0f x %.1f cents", size, interval);
+            break;
+        default:
+            return fFileBaseName[sclState].buffer();
+        }
+        
+        return fGeneratorLabel[corner];
+    }
     
     // ----------------------------------------------------------------------------------------------------------------
     // Widget Callbacks
@@ -376,6 +826,39 @@ protected:
 			return;
 		}
 		
+		// The log file is kept in state; the DSP writes to it while logging is on
+		if (file_browser_target == kBrowseLog)
+		{
+			fState[kStateLogFile] = filename;
+			setState("log_file", filename);
+			return;
+		}
+		
+		// DPF's browser picks files, so a library folder is chosen by picking any file in it
+		if (file_browser_target == kBrowseLibrary)
+		{
+			std::string folder(filename);
+			folder = folder.substr(0, folder.find_last_of("/\\"));
+			
+			std::string folders(fState[kStateLibraryFolders].buffer());
+			std::vector<std::string> known = ScaleLibrary::splitFolders(folders.c_str());
+			
+			if (std::find(known.begin(), known.end(), folder) == known.end())
+			{
+				folders += folders.empty() ? folder : "\n" + folder;
+				setState("library_folders", folders.c_str());
+				stateChanged("library_folders", folders.c_str());
+			}
+			return;
+		}
+		
+		if (file_browser_target == kBrowsePack)
+		{
+			setState("library_pack", filename);
+			stateChanged("library_pack", filename);
+			return;
+		}
+		
 		// Setting the "file_save_path" state triggers saving on the plugin side
         setState("file_save_path", filename);
         
@@ -408,6 +891,15 @@ protected:
             //ImGui::PopStyleColor();
             ImGui::PopFont();
             
+            // Another instance holds the MTS-ESP master slot; this one takes over when it is released
+            if (fParameters[kParameterPassive] > 0.5f)
+            {
+                ImGui::SameLine();
+                ImGui::PushFont(lektonRegularFont);
+                ImGui::TextDisabled("Passive: another MTS-ESP master is active");
+                ImGui::PopFont();
+            }
+            
             ImGui::EndChild(); // title pane
             
             ImGui::BeginChild("top pane", ImVec2(0, 500 * scale_factor)); // top pane holds four columns (one column is space)
@@ -436,7 +928,7 @@ protected:
 			}
 			
 			ImGui::PushItemWidth(-1);
-			ImGui::LabelText("##scale_1_scl", fFileBaseName[kStateFileSCL1]);
+			ImGui::LabelText("##scale_1_scl", "%s", cornerSclLabel(0, kStateFileSCL1));
 			ImGui::LabelText("##scale_1_kbm", fFileBaseName[kStateFileKBM1]);
             ImGui::PopItemWidth();
             
@@ -470,7 +962,7 @@ protected:
 			}
 			
 			ImGui::PushItemWidth(-1);
-			ImGui::LabelText("##scale_3_scl", fFileBaseName[kStateFileSCL3]);
+			ImGui::LabelText("##scale_3_scl", "%s", cornerSclLabel(2, kStateFileSCL3));
 			ImGui::LabelText("##scale_3_kbm", fFileBaseName[kStateFileKBM3]);
             ImGui::PopItemWidth();
             
@@ -509,6 +1001,9 @@ protected:
                 editParameter(kParameterX, false);
                 editParameter(kParameterY, false);
             }
+            
+            if (fParameters[kParameterAtlasEnable] > 0.5f and fAtlas.getCount() > 0)
+                drawAtlas(ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
 	        
             ImGui::EndChild(); // middle pane
             
@@ -539,7 +1034,7 @@ protected:
 			}
 			
 			ImGui::PushItemWidth(-1);
-			ImGui::LabelText("##scale_2_scl", fFileBaseName[kStateFileSCL2]);
+			ImGui::LabelText("##scale_2_scl", "%s", cornerSclLabel(1, kStateFileSCL2));
 			ImGui::LabelText("##scale_2_kbm", fFileBaseName[kStateFileKBM2]);
             ImGui::PopItemWidth();
             
@@ -573,7 +1068,7 @@ protected:
 			}
 			
 			ImGui::PushItemWidth(-1);
-			ImGui::LabelText("##scale_4_scl", fFileBaseName[kStateFileSCL4]);
+			ImGui::LabelText("##scale_4_scl", "%s", cornerSclLabel(3, kStateFileSCL4));
 			ImGui::LabelText("##scale_4_kbm", fFileBaseName[kStateFileKBM4]);
             ImGui::PopItemWidth();
             
@@ -583,33 +1078,519 @@ protected:
             
             ImGui::EndChild(); // top pane
             
-            ImGui::BeginChild("bottom pane", ImVec2(0, ImGui::GetFontSize() * 3));
-            
-            ImGui::BeginChild("bottom left spacer pane", ImVec2(UI_COLUMN_WIDTH * 0.94f, ImGui::GetFontSize() * 3));
-
-            ImGui::EndChild(); // bottom left spacer pane pane
-            
-            ImGui::SameLine(); 
-            
-            ImGui::BeginChild("Export pane", ImVec2(UI_COLUMN_WIDTH * 2.6f, ImGui::GetFontSize() * 3));
+            ImGui::BeginChild("bottom pane", ImVec2(0, ImGui::GetFontSize() * 8));
             
-            if (ImGui::Button("EXPORT"))
-			{
-				if (!file_browser_open)
-				{
-					FileBrowserOptions opts;
-					opts.saving = true;
-					opts.title = "Export scale to SCL and KBM pair";
-					file_browser_open = true;
-					openFileBrowser(opts);
-				}
-			}
-			
-			ImGui::SameLine(); 
-			
-			ImGui::LabelText("##export_label", "Save current scale as SCL & KBM pair");
-            
-            ImGui::EndChild(); // export pane
+            if (ImGui::BeginTabBar("settings tabs"))
+            {
+                if (ImGui::BeginTabItem("Export"))
+                {
+                    if (ImGui::Button("EXPORT"))
+                    {
+                        if (!file_browser_open)
+                        {
+                            FileBrowserOptions opts;
+                            opts.saving = true;
+                            opts.title = "Export scale to SCL and KBM pair";
+                            file_browser_open = true;
+                            file_browser_target = kBrowseExport;
+                            openFileBrowser(opts);
+                        }
+                    }
+                    
+                    ImGui::SameLine(); 
+                    
+                    ImGui::LabelText("##export_label", "Save current scale as SCL & KBM pair");
+                    
+                    // Notes the DSP had to repair before publishing (bad or extreme scale files)
+                    if (fParameters[kParameterReplacedNotes] > 0.0f or fParameters[kParameterClampedNotes] > 0.0f)
+                    {
+                        ImGui::PushFont(lektonRegularFont);
+                        ImGui::Text("Guarded notes: %d replaced, %d clamped", static_cast<int>(fParameters[kParameterReplacedNotes]), static_cast<int>(fParameters[kParameterClampedNotes]));
+                        ImGui::PopFont();
+                    }
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("MIDI"))
+                {
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    parameterSlider("Adaptive JI", kParameterJustIntonation);
+                    ImGui::PopItemWidth();
+                    
+                    parameterCheckbox("Hold Sounding Notes", kParameterHoldNotes);
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Input"))
+                {
+                    static const char* const trackingModes[kTrackingModeCount] = { "Off", "Pitch Class", "Auto Corner" };
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    parameterCombo("Pitch Tracking", kParameterTrackingMode, trackingModes, kTrackingModeCount);
+                    ImGui::PopItemWidth();
+                    
+                    if (static_cast<int>(fParameters[kParameterTrackingMode]) != kTrackingOff)
+                    {
+                        ImGui::PushFont(lektonRegularFont);
+                        if (fParameters[kParameterDetectedPitch] > 0.0f)
+                            ImGui::Text("Detected pitch: %.2f Hz", fParameters[kParameterDetectedPitch]);
+                        else
+                            ImGui::Text("Detected pitch: none");
+                        ImGui::Text("Tracked position: X %.2f, Y %.2f", fParameters[kParameterTrackedX], fParameters[kParameterTrackedY]);
+                        ImGui::PopFont();
+                    }
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Shape"))
+                {
+                    static const char* const warpCurves[kWarpCurveCount] = { "Linear", "Ease In", "Ease Out", "Ease In/Out", "Power" };
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.6f);
+                    
+                    parameterSlider("##gain_1", kParameterCornerGain1, "Scale 1 gain %.2f");
+                    ImGui::SameLine();
+                    parameterSlider("##gain_2", kParameterCornerGain2, "Scale 2 gain %.2f");
+                    ImGui::SameLine();
+                    parameterCombo("X Warp", kParameterWarpX, warpCurves, kWarpCurveCount);
+                    
+                    parameterSlider("##gain_3", kParameterCornerGain3, "Scale 3 gain %.2f");
+                    ImGui::SameLine();
+                    parameterSlider("##gain_4", kParameterCornerGain4, "Scale 4 gain %.2f");
+                    ImGui::SameLine();
+                    parameterCombo("Y Warp", kParameterWarpY, warpCurves, kWarpCurveCount);
+                    
+                    parameterSlider("##warp_power", kParameterWarpPower, "Warp power %.2f");
+                    
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Reference"))
+                {
+                    parameterCheckbox("Align scales to a common reference before blending", kParameterAlignReference);
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    parameterSlider("Reference Note", kParameterAlignNote, "%.0f");
+                    parameterSlider("Reference Frequency", kParameterAlignFrequency, "%.3f Hz");
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Zones"))
+                {
+                    static const char* const zoneModes[kZoneModeCount] = { "Off", "Zones", "Gradient" };
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    parameterCombo("Zone Mode", kParameterZoneMode, zoneModes, kZoneModeCount);
+                    ImGui::PopItemWidth();
+                    
+                    const int zoneMode = static_cast<int>(fParameters[kParameterZoneMode]);
+                    const float zoneSliderWidth = UI_COLUMN_WIDTH * 0.6f;
+                    
+                    ImGui::PushItemWidth(zoneSliderWidth);
+                    
+                    if (zoneMode == kZoneModeZones)
+                    {
+                        // Zone 1 runs from note 0 and uses the XY slider
+                        parameterSlider("##zone_2_start", kParameterZone2Start, "Zone 2 from note %.0f");
+                        ImGui::SameLine();
+                        parameterSlider("##zone_2_x", kParameterZone2X, "X %.2f");
+                        ImGui::SameLine();
+                        parameterSlider("##zone_2_y", kParameterZone2Y, "Y %.2f");
+                        
+                        parameterSlider("##zone_3_start", kParameterZone3Start, "Zone 3 from note %.0f");
+                        ImGui::SameLine();
+                        parameterSlider("##zone_3_x", kParameterZone3X, "X %.2f");
+                        ImGui::SameLine();
+                        parameterSlider("##zone_3_y", kParameterZone3Y, "Y %.2f");
+                        
+                        parameterSlider("##zone_4_start", kParameterZone4Start, "Zone 4 from note %.0f");
+                        ImGui::SameLine();
+                        parameterSlider("##zone_4_x", kParameterZone4X, "X %.2f");
+                        ImGui::SameLine();
+                        parameterSlider("##zone_4_y", kParameterZone4Y, "Y %.2f");
+                    }
+                    else if (zoneMode == kZoneModeGradient)
+                    {
+                        // The XY slider sets the low register, zone 2's position the high register
+                        parameterSlider("##gradient_low", kParameterGradientLow, "Low note %.0f");
+                        ImGui::SameLine();
+                        parameterSlider("##gradient_high", kParameterGradientHigh, "High note %.0f");
+                        
+                        parameterSlider("##gradient_x", kParameterZone2X, "High X %.2f");
+                        ImGui::SameLine();
+                        parameterSlider("##gradient_y", kParameterZone2Y, "High Y %.2f");
+                    }
+                    
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Grid"))
+                {
+                    if (ImGui::Button("Open SCL File##grid"))
+                    {
+                        requestStateFile(kStateKeys[kStateFileSCLGrid]);
+                    }
+                    
+                    ImGui::SameLine();
+                    ImGui::LabelText("##grid_scl", fFileBaseName[kStateFileSCLGrid]);
+                    
+                    if (ImGui::Button("Open KBM File##grid"))
+                    {
+                        requestStateFile(kStateKeys[kStateFileKBMGrid]);
+                    }
+                    
+                    ImGui::SameLine();
+                    ImGui::LabelText("##grid_kbm", fFileBaseName[kStateFileKBMGrid]);
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    parameterSlider("Grid Strength", kParameterGridStrength);
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Slots"))
+                {
+                    const int activeSlot = static_cast<int>(fParameters[kParameterActiveSlot]);
+                    
+                    parameterCheckbox("Keyswitches", kParameterKeyswitchEnable);
+                    ImGui::SameLine();
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.6f);
+                    parameterSlider("##keyswitch_base", kParameterKeyswitchBase, "Base note %.0f");
+                    ImGui::SameLine();
+                    parameterSlider("##crossfade_time", kParameterCrossfadeTime, "Crossfade %.0f ms");
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    ImGui::Text("Base note selects the live scale space%s, the next %d notes select the slots.", activeSlot == 0 ? " (active)" : "", kSlotCount);
+                    ImGui::PopFont();
+                    
+                    if (ImGui::Button("SCL##slot_1"))
+                        requestStateFile(kStateKeys[kStateFileSCLSlot1]);
+                    ImGui::SameLine();
+                    if (ImGui::Button("KBM##slot_1"))
+                        requestStateFile(kStateKeys[kStateFileKBMSlot1]);
+                    ImGui::SameLine();
+                    ImGui::Text("Slot 1%s %s / %s", activeSlot == 1 ? " (active)" : "", fFileBaseName[kStateFileSCLSlot1].buffer(), fFileBaseName[kStateFileKBMSlot1].buffer());
+                    ImGui::SameLine(UI_COLUMN_WIDTH * 1.6f);
+                    if (ImGui::Button("SCL##slot_2"))
+                        requestStateFile(kStateKeys[kStateFileSCLSlot2]);
+                    ImGui::SameLine();
+                    if (ImGui::Button("KBM##slot_2"))
+                        requestStateFile(kStateKeys[kStateFileKBMSlot2]);
+                    ImGui::SameLine();
+                    ImGui::Text("Slot 2%s %s / %s", activeSlot == 2 ? " (active)" : "", fFileBaseName[kStateFileSCLSlot2].buffer(), fFileBaseName[kStateFileKBMSlot2].buffer());
+                    if (ImGui::Button("SCL##slot_3"))
+                        requestStateFile(kStateKeys[kStateFileSCLSlot3]);
+                    ImGui::SameLine();
+                    if (ImGui::Button("KBM##slot_3"))
+                        requestStateFile(kStateKeys[kStateFileKBMSlot3]);
+                    ImGui::SameLine();
+                    ImGui::Text("Slot 3%s %s / %s", activeSlot == 3 ? " (active)" : "", fFileBaseName[kStateFileSCLSlot3].buffer(), fFileBaseName[kStateFileKBMSlot3].buffer());
+                    ImGui::SameLine(UI_COLUMN_WIDTH * 1.6f);
+                    if (ImGui::Button("SCL##slot_4"))
+                        requestStateFile(kStateKeys[kStateFileSCLSlot4]);
+                    ImGui::SameLine();
+                    if (ImGui::Button("KBM##slot_4"))
+                        requestStateFile(kStateKeys[kStateFileKBMSlot4]);
+                    ImGui::SameLine();
+                    ImGui::Text("Slot 4%s %s / %s", activeSlot == 4 ? " (active)" : "", fFileBaseName[kStateFileSCLSlot4].buffer(), fFileBaseName[kStateFileKBMSlot4].buffer());
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Transform"))
+                {
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.6f);
+                    parameterSlider("##transpose_1", kParameterTranspose1, "Scale 1 %+.1f cents");
+                    ImGui::SameLine();
+                    parameterSlider("##transpose_2", kParameterTranspose2, "Scale 2 %+.1f cents");
+                    parameterSlider("##transpose_3", kParameterTranspose3, "Scale 3 %+.1f cents");
+                    ImGui::SameLine();
+                    parameterSlider("##transpose_4", kParameterTranspose4, "Scale 4 %+.1f cents");
+                    parameterSlider("##octave_stretch", kParameterOctaveStretch, "Stretch %+.2f cents/oct");
+                    ImGui::SameLine();
+                    parameterSlider("##reference_trim", kParameterReferenceTrim, "Trim %+.2f cents");
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Generators"))
+                {
+                    static const char* const corners[4] = { "Scale 1", "Scale 2", "Scale 3", "Scale 4" };
+                    static const char* const generatorTypes[kGeneratorTypeCount] = { "File", "EDO", "Harmonic", "Subharmonic", "MOS" };
+                    
+                    const int32_t base = kParameterGenerator1 + generatorCorner * kGeneratorStride;
+                    const int32_t type = static_cast<int32_t>(fParameters[base]);
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.6f);
+                    ImGui::Combo("##generator_corner", &generatorCorner, corners, 4);
+                    ImGui::SameLine();
+                    parameterCombo("##generator_type", static_cast<Parameters>(base), generatorTypes, kGeneratorTypeCount);
+                    
+                    if (type != kGeneratorFile)
+                    {
+                        parameterSlider("##generator_size", static_cast<Parameters>(base + 1), type == kGeneratorEDO ? "%.2f divisions" : (type == kGeneratorMOS ? "%.0f notes" : "%.2f notes"));
+                        ImGui::SameLine();
+                        parameterSlider("##generator_period", static_cast<Parameters>(base + 3), "Period %.1f cents");
+                        
+                        if (type == kGeneratorMOS)
+                            parameterSlider("##generator_interval", static_cast<Parameters>(base + 2), "Generator %.2f cents");
+                    }
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    if (type == kGeneratorFile)
+                        ImGui::Text("This scale comes from its SCL / KBM files.");
+                    else
+                        ImGui::Text("Generated from middle C at 261.6256 Hz. Loaded files are kept for when File is chosen again.");
+                    ImGui::PopFont();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Pins"))
+                {
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.6f);
+                    ImGui::SliderInt("##override_note", &overrideNote, 0, 127, "Note %d");
+                    ImGui::SameLine();
+                    ImGui::InputDouble("##override_frequency", &overrideFrequency, 0.0, 0.0, "%.4f Hz");
+                    ImGui::PopItemWidth();
+                    overrideFrequency = limit(overrideFrequency, kMinNoteFrequency, kMaxNoteFrequency);
+                    
+                    ImGui::SameLine();
+                    if (ImGui::Button("Pin"))
+                    {
+                        fOverrides.pin(overrideNote, overrideFrequency);
+                        sendOverrides();
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Unpin"))
+                    {
+                        fOverrides.unpin(overrideNote);
+                        sendOverrides();
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear All"))
+                    {
+                        fOverrides.clear();
+                        sendOverrides();
+                    }
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    if ((fOverrides.mask[0] | fOverrides.mask[1]) == 0)
+                        ImGui::Text("No pinned notes. Pinned notes keep their frequency wherever the XY slider is.");
+                    else
+                        ImGui::TextWrapped("Pinned: %s", fOverridesText.c_str());
+                    ImGui::PopFont();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Preview"))
+                {
+                    static const char* const previewModes[kPreviewModeCount] = { "Off", "MIDI", "Chord" };
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.6f);
+                    parameterCombo("##preview_mode", kParameterPreviewMode, previewModes, kPreviewModeCount);
+                    ImGui::SameLine();
+                    parameterSlider("##preview_level", kParameterPreviewLevel, "Level %.2f");
+                    
+                    if (static_cast<int>(fParameters[kParameterPreviewMode]) == kPreviewChord)
+                        parameterSlider("##preview_chord_root", kParameterPreviewChordRoot, "Chord root %.0f");
+                    ImGui::PopItemWidth();
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    ImGui::Text("Plays MIDI input or a reference chord on the plugin's stereo output, at the current tuning.");
+                    ImGui::PopFont();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Library"))
+                {
+                    if (ImGui::Button("Add Folder") and !file_browser_open)
+                    {
+                        FileBrowserOptions opts;
+                        opts.title = "Choose any file in a scale folder";
+                        file_browser_open = true;
+                        file_browser_target = kBrowseLibrary;
+                        openFileBrowser(opts);
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear Folders"))
+                    {
+                        setState("library_folders", "");
+                        stateChanged("library_folders", "");
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Open Pack") and !file_browser_open)
+                    {
+                        FileBrowserOptions opts;
+                        opts.title = "Open a .sspack scale pack";
+                        file_browser_open = true;
+                        file_browser_target = kBrowsePack;
+                        openFileBrowser(opts);
+                    }
+                    if (fLibraryPack.isOpen())
+                    {
+                        ImGui::SameLine();
+                        if (ImGui::Button("Close Pack"))
+                        {
+                            setState("library_pack", "");
+                            stateChanged("library_pack", "");
+                        }
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Rescan"))
+                        fLibraryScanner.start(ScaleLibrary::splitFolders(fState[kStateLibraryFolders].buffer()), fLibrary, fLibraryIndexPath);
+                    
+                    ImGui::SameLine();
+                    ImGui::PushFont(lektonRegularFont);
+                    if (fLibraryScanner.isBusy())
+                        ImGui::Text("Scanning %u / %u", fLibraryScanner.getDone(), fLibraryScanner.getTotal());
+                    else
+                        ImGui::Text("%d scales", static_cast<int>(fLibrary.records.size() + fLibraryPack.getCount()));
+                    ImGui::PopFont();
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    if (ImGui::InputTextWithHint("##library_filter", "Filter by name or description", fLibraryFilter, sizeof(fLibraryFilter)))
+                        updateLibraryView();
+                    ImGui::SameLine();
+                    ImGui::SliderInt("##library_corner", &libraryCorner, 1, 4, "Load into corner %d");
+                    ImGui::PopItemWidth();
+                    
+                    if (ImGui::Button("Find Similar") and !similarPending)
+                    {
+                        if (EditorLink* const snapshot = editorLink())
+                        {
+                            snapshot->requestSnapshot();
+                            similarPending = true;
+                            similarRequested = std::chrono::steady_clock::now();
+                        }
+                        else
+                        {
+                            errorText = "Similar scale search needs the editor\nto run in the same process as the plugin.";
+                            show_error_popup = true;
+                        }
+                    }
+                    if (!fSimilar.empty())
+                    {
+                        ImGui::SameLine();
+                        if (ImGui::Button("Clear Results"))
+                            fSimilar.clear();
+                    }
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    ImGui::SameLine();
+                    if (similarPending)
+                        ImGui::Text("Searching...");
+                    else if (!fSimilar.empty())
+                        ImGui::Text("Closest library scales to the current tuning:");
+                    
+                    for (const ScaleSearch::Match& match : fSimilar)
+                    {
+                        const ScaleLibrary::Entry entry = libraryEntry(match.row);
+                        char label[512];
+                        std::snprintf(label, sizeof(label), "%5.3f  %s  (%d notes, %.1f cents)##similar_%u",
+                                      match.distance, entry.name, entry.note_count, entry.period_cents, match.row);
+                        
+                        if (ImGui::Selectable(label))
+                            loadLibraryScale(match.row, libraryCorner);
+                    }
+                    ImGui::PopFont();
+                    
+                    parameterCheckbox("Scale Atlas", kParameterAtlasEnable);
+                    ImGui::SameLine();
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH * 0.5f);
+                    parameterSlider("##atlas_neighbours", kParameterAtlasNeighbours, "Blend %.0f nearest");
+                    ImGui::PopItemWidth();
+                    ImGui::SameLine();
+                    if (ImGui::Button("Build Atlas") and !fAtlasBuilder.isBusy())
+                        buildAtlas();
+                    
+                    ImGui::SameLine();
+                    ImGui::PushFont(lektonRegularFont);
+                    if (fAtlasBuilder.isBusy())
+                        ImGui::Text("Building atlas...");
+                    else if (fAtlas.getCount() > 0)
+                        ImGui::Text("%u scales in atlas", fAtlas.getCount());
+                    else
+                        ImGui::Text("(no atlas)");
+                    ImGui::PopFont();
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    ImGui::BeginChild("##library_list", ImVec2(0, 0), true);
+                    
+                    ImGuiListClipper clipper;
+                    clipper.Begin(static_cast<int>(fLibraryView.size()));
+                    
+                    while (clipper.Step())
+                    {
+                        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+                        {
+                            const ScaleLibrary::Entry entry = libraryEntry(fLibraryView[row]);
+                            char label[512];
+                            std::snprintf(label, sizeof(label), "%s  (%d notes, %.1f cents)  %s##library_%u",
+                                          entry.name, entry.note_count, entry.period_cents, entry.description, fLibraryView[row]);
+                            
+                            if (ImGui::Selectable(label))
+                                loadLibraryScale(fLibraryView[row], libraryCorner);
+                        }
+                    }
+                    
+                    ImGui::EndChild();
+                    ImGui::PopFont();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                if (ImGui::BeginTabItem("Output"))
+                {
+                    parameterCheckbox("Send MTS SysEx to MIDI output", kParameterSysexOutput);
+                    
+                    ImGui::PushItemWidth(UI_COLUMN_WIDTH);
+                    parameterSlider("SysEx Device ID", kParameterSysexDevice, "%.0f");
+                    parameterSlider("Deadband", kParameterDeadband, "%.2f cents");
+                    ImGui::PopItemWidth();
+                    
+                    parameterCheckbox("Log tunings", kParameterLogEnable);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Log File") and !file_browser_open)
+                    {
+                        FileBrowserOptions opts;
+                        opts.saving = true;
+                        opts.title = "Choose tuning log file";
+                        file_browser_open = true;
+                        file_browser_target = kBrowseLog;
+                        openFileBrowser(opts);
+                    }
+                    ImGui::SameLine();
+                    ImGui::TextUnformatted(fState[kStateLogFile].isNotEmpty() ? fState[kStateLogFile].buffer() : "(no log file)");
+                    
+                    ImGui::PushFont(lektonRegularFont);
+                    ImGui::Text("Update rate: %.0f Hz", fParameters[kParameterUpdateRate]);
+                    if (fParameters[kParameterDeadband] > 0.0f)
+                        ImGui::Text("Suppressed updates: %d", static_cast<int>(fParameters[kParameterSuppressedUpdates]));
+                    if (fParameters[kParameterLogDropped] > 0.0f)
+                        ImGui::Text("Dropped log entries: %d", static_cast<int>(fParameters[kParameterLogDropped]));
+                    ImGui::PopFont();
+                    
+                    ImGui::EndTabItem();
+                }
+                
+                ImGui::EndTabBar();
+            }
             
             ImGui::EndChild(); // bottom pane
             
@@ -639,7 +1620,18 @@ private:
     String fState[kStateCount];
     String fFileBaseName[kStateCount];
     
-    Tunings::Tuning utuning1, utuning2, utuning3, utuning4;
+    ScaleCache::Handle utuning1, utuning2, utuning3, utuning4, utuningGrid;
+    ScaleCache::Handle utuningSlot[kSlotCount];
+    
+    // Corner shown on the Generators tab, and the text shown for generated corners
+    int generatorCorner;
+    char fGeneratorLabel[4][48];
+    
+    // Pinned notes, edited here and sent to the DSP as the note_overrides state
+    NoteOverrides fOverrides;
+    std::string fOverridesText;
+    int overrideNote;
+    double overrideFrequency;
 
     // UI stuff
     double scale_factor;
@@ -656,6 +1648,43 @@ private:
     // file_browser_open is used to prevent more than one file browser
     // window being open at the same time
     bool file_browser_open;
+    
+    // what the open file browser is choosing
+    enum FileBrowserTarget {
+        kBrowseExport,
+        kBrowseLog,
+        kBrowseLibrary,
+        kBrowsePack
+    };
+    FileBrowserTarget file_browser_target;
+    
+    // Scale library: the index shown on the Library tab, the scan that updates it, an
+    // optional scale pack, and the rows that match the filter text. Rows with
+    // kLibraryPackRow set are pack records, the others index records.
+    static constexpr uint32_t kLibraryPackRow = 0x80000000u;
+    ScaleLibrary::Index fLibrary;
+    ScaleLibraryScanner fLibraryScanner;
+    std::string fLibraryIndexPath;
+    ScalePack fLibraryPack;
+    std::vector<uint32_t> fLibraryView;
+    char fLibraryFilter[64];
+    int libraryCorner;
+    
+    // Nearest library scales to the DSP's current tuning, while waiting for the DSP's table and after
+    static constexpr uint32_t kSimilarCount = 8;
+    static constexpr int kSimilarTimeoutSeconds = 1;
+    std::vector<ScaleSearch::Match> fSimilar;
+    bool similarPending;
+    std::chrono::steady_clock::time_point similarRequested;
+    
+    // Link to the DSP's parse results and snapshots, found by the id the DSP reports
+    uint32_t fEditorLinkId;
+    std::shared_ptr<EditorLink> fEditorLink;
+    
+    // Scale atlas: the library laid out on the pad, built in the background and loaded
+    // here for drawing and by the DSP for blending
+    ScaleAtlas fAtlas;
+    ScaleAtlasBuilder fAtlasBuilder;
 
     DISTRHO_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ScaleSpaceUI)
 };